@@ -0,0 +1,38 @@
+# math library microbenchmarks - no SDL/Vulkan needed
+# eg. make bench-math SIMDFLAGS="-mavx2 -mfma" BENCHARGS="--baseline math.baseline"
+# (SIMDFLAGS=-DMATH_NO_SIMD times the scalar fallbacks, run make cleanbench when switching flags)
+SIMDFLAGS ?=
+BENCHARGS ?=
+INCLUDES = -I../src
+CXXFLAGS = -O3 $(SIMDFLAGS) -std=c++17
+DEFINES = -DNDEBUG
+BUILD = bench
+TARGET = MathBench
+
+SOURCES = \
+	../src/bench/MathBench.cpp \
+	../src/Math.cpp \
+	../src/MathFrustum.cpp \
+	../src/MathStream.cpp
+
+OBJS := $(patsubst ../%.cpp,$(BUILD)/%.o,$(SOURCES))
+
+run: $(TARGET)
+	./$(TARGET) $(BENCHARGS)
+
+clean:
+	rm -rf $(BUILD)
+	rm -f $(TARGET)
+
+$(TARGET): $(OBJS)
+	$(CXX) $(OBJS) $(CXXFLAGS) -o $(TARGET)
+
+$(BUILD)/%.o: ../%.cpp
+	@mkdir -p $(@D)
+	$(CXX) -c -MMD -MP $(INCLUDES) $(CXXFLAGS) $(DEFINES) $< -o $@
+
+ifneq "$(MAKECMDGOALS)" "clean"
+-include $(OBJS:.o=.d)
+endif
+
+.PHONY: run clean
@@ -1,7 +1,9 @@
 INCLUDES = -I$(VULKAN_SDK)/x86_64/include -I../contrib -I../src
-CFLAGS := $(OPTFLAGS) $(shell pkg-config --cflags sdl2)
-CXXFLAGS = $(CFLAGS) -std=c++14
-LDFLAGS = -L$(VULKAN_SDK)/x86_64/lib -lvulkan $(shell pkg-config --libs sdl2)
+# extra target flags, eg. make release SIMDFLAGS="-mavx2 -mfma"
+SIMDFLAGS ?=
+CFLAGS := $(OPTFLAGS) $(SIMDFLAGS) -pthread $(shell pkg-config --cflags sdl2)
+CXXFLAGS = $(CFLAGS) -std=c++17
+LDFLAGS = -L$(VULKAN_SDK)/x86_64/lib -lvulkan -pthread $(shell pkg-config --libs sdl2)
 
 include sources.mk
 BUILDDIR = $(BUILD)/build
@@ -3,9 +3,15 @@ SOURCES = \
 	../src/renderer/vulkan/Base.cpp \
 	../src/renderer/vulkan/Buffers.cpp \
 	../src/renderer/vulkan/CmdBuffer.cpp \
+	../src/renderer/vulkan/DeletionQueue.cpp \
 	../src/renderer/vulkan/Device.cpp \
+	../src/renderer/vulkan/FrameContext.cpp \
 	../src/renderer/vulkan/Image.cpp \
 	../src/renderer/vulkan/Pipeline.cpp \
+	../src/renderer/vulkan/PipelineCache.cpp \
+	../src/renderer/vulkan/PipelineCompiler.cpp \
+	../src/renderer/vulkan/RenderGraph.cpp \
+	../src/renderer/vulkan/Sync.cpp \
 	../src/renderer/vulkan/Validation.cpp \
 	../src/renderer/vulkan/VkMemAlloc.cpp \
 	../src/renderer/Camera.cpp \
@@ -16,9 +22,12 @@ SOURCES = \
 	../src/renderer/TextureManager.cpp \
 	../src/Application.cpp \
 	../src/DebugOverlay.cpp \
+	../src/FrameTimer.cpp \
 	../src/InputHandlers.cpp \
 	../src/main.cpp \
 	../src/Math.cpp \
+	../src/MathFrustum.cpp \
+	../src/MathStream.cpp \
 	../src/Utils.cpp
 
 TARGET = VkPlayground
@@ -4,3 +4,5 @@ $VULKAN_SDK/macOS/bin/glslangValidator -V res/Basic.vert -o res/Basic_vert.spv
 $VULKAN_SDK/macOS/bin/glslangValidator -V res/Basic.frag -o res/Basic_frag.spv
 $VULKAN_SDK/macOS/bin/glslangValidator -V res/Font.vert -o res/Font_vert.spv
 $VULKAN_SDK/macOS/bin/glslangValidator -V res/Font.frag -o res/Font_frag.spv
+$VULKAN_SDK/macOS/bin/glslangValidator -V res/Fxaa.vert -o res/Fxaa_vert.spv
+$VULKAN_SDK/macOS/bin/glslangValidator -V res/Fxaa.frag -o res/Fxaa_frag.spv
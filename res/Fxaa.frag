@@ -0,0 +1,58 @@
+#version 450
+layout(binding = 0) uniform sampler2D sScene;
+
+layout(push_constant) uniform FxaaParams
+{
+    vec2 rcpFrame; // texel size of the scene target
+    vec2 uvMax;    // last rendered texel center - the target may be larger than the visible area
+} params;
+
+layout(location = 0) out vec4 fragmentColor;
+
+#define FXAA_REDUCE_MIN (1.0 / 128.0)
+#define FXAA_REDUCE_MUL (1.0 / 8.0)
+#define FXAA_SPAN_MAX   8.0
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 fetch(vec2 uv)
+{
+    return texture(sScene, min(uv, params.uvMax)).rgb;
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy * params.rcpFrame;
+
+    vec3 rgbM  = fetch(uv);
+    float lumaNW = luma(fetch(uv + vec2(-1.0, -1.0) * params.rcpFrame));
+    float lumaNE = luma(fetch(uv + vec2( 1.0, -1.0) * params.rcpFrame));
+    float lumaSW = luma(fetch(uv + vec2(-1.0,  1.0) * params.rcpFrame));
+    float lumaSE = luma(fetch(uv + vec2( 1.0,  1.0) * params.rcpFrame));
+    float lumaM  = luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // blur direction is perpendicular to the local luma gradient
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * params.rcpFrame;
+
+    vec3 rgbA = 0.5 * (fetch(uv + dir * (1.0 / 3.0 - 0.5)) + fetch(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (fetch(uv + dir * -0.5) + fetch(uv + dir * 0.5));
+
+    // the wider sample set crossed an edge - fall back to the narrow one
+    float lumaB = luma(rgbB);
+    if (lumaB < lumaMin || lumaB > lumaMax)
+        fragmentColor = vec4(rgbA, 1.0);
+    else
+        fragmentColor = vec4(rgbB, 1.0);
+}
@@ -1,4 +1,6 @@
 %VULKAN_SDK%\bin32\glslangValidator.exe -V res/Basic.vert -o res/Basic_vert.spv
 %VULKAN_SDK%\bin32\glslangValidator.exe -V res/Basic.frag -o res/Basic_frag.spv
 %VULKAN_SDK%\bin32\glslangValidator.exe -V res/Font.vert -o res/Font_vert.spv
-%VULKAN_SDK%\bin32\glslangValidator.exe -V res/Font.frag -o res/Font_frag.spv
\ No newline at end of file
+%VULKAN_SDK%\bin32\glslangValidator.exe -V res/Font.frag -o res/Font_frag.spv
+%VULKAN_SDK%\bin32\glslangValidator.exe -V res/Fxaa.vert -o res/Fxaa_vert.spv
+%VULKAN_SDK%\bin32\glslangValidator.exe -V res/Fxaa.frag -o res/Fxaa_frag.spv
\ No newline at end of file
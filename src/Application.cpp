@@ -21,9 +21,10 @@ void Application::OnWindowResize(int newWidth, int newHeight)
     // skip drawing if either dimension is zero
     m_noRedraw = !(windowSize.m_x > 0 && windowSize.m_y > 0);
 
-    // window size changed - recreate the swapchain here since some drivers (Intel) can't properly invalidate it
+    // window size changed - rebuild the swapchain since some drivers (Intel) can't properly invalidate it
+    // (bursts of resize events, e.g. while dragging the window border, end up in one rebuild on the next frame)
     if (!m_noRedraw)
-        g_renderContext.RecreateSwapChain();
+        g_renderContext.RequestSwapChainRebuild();
 }
 
 void Application::OnWindowMinimized(bool minimized)
@@ -33,7 +34,7 @@ void Application::OnWindowMinimized(bool minimized)
 
 void Application::OnStart(int argc, char **argv)
 {
-    m_pipeline.cache = g_renderContext.pipelineCache;
+    m_pipeline.cache = &g_renderContext.pipelineCache;
     m_texture = TextureManager::GetInstance()->LoadTexture("res/block_blue.png");
 
     // create a common descriptor set layout and vertex buffer info
@@ -42,9 +43,6 @@ void Application::OnStart(int argc, char **argv)
     m_vbInfo.attributeDescriptions.push_back(vk::getAttributeDescription(inTexCoord, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3));
     CreateDescriptorSetLayout();
 
-    // single shared uniform buffer
-    VK_VERIFY(vk::createUniformBuffer(g_renderContext.device, sizeof(UniformBufferObject), &m_uniformBuffer));
-
     /* Create buffers here */
     m_descriptor.setLayout = m_dsLayout;
 
@@ -55,6 +53,9 @@ void Application::OnStart(int argc, char **argv)
 
     const uint32_t indices[6] = { 0, 1, 2, 1, 3, 2 };
 
+    m_quadBounds.m_min = Math::Vector3f(0.f, 0.f, -1.f);
+    m_quadBounds.m_max = Math::Vector3f(1.f, 1.f, -1.f);
+
     // vertex buffer and index buffer with staging buffer
     vk::createVertexBuffer(g_renderContext.device, verts, sizeof(Vertex) * 4, &m_vertexBuffer);
     vk::createIndexBuffer(g_renderContext.device, indices, sizeof(uint32_t) * 6, &m_indexBuffer);
@@ -71,21 +72,31 @@ void Application::OnStart(int argc, char **argv)
     // set to "clean" perspective matrix
     g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_FPS);
     m_debugOverlay = new DebugOverlay();
+    m_debugOverlay->SetAAMode(RenderContext::AAModeName(g_renderContext.ActiveAAMode()));
+    m_debugOverlay->SetPresentMode(RenderContext::PresentModeName(g_renderContext.ActivePresentMode()), g_renderContext.MaxQueuedFrames(), g_renderContext.lateLatching);
 }
 
-void Application::OnRender()
+void Application::OnRender(float frameTime)
 {
+    m_debugOverlay->OnFrameStart(frameTime, g_renderContext.GpuFrameTime());
+    m_debugOverlay->OnPresent(g_renderContext.PresentInterval(), g_renderContext.InputLatency());
+
+    // minimized or zero-sized window - a good moment to persist pipelines built so far
     if (m_noRedraw)
+    {
+        g_renderContext.SavePipelineCache();
         return;
+    }
 
     // incompatible swapchain - skip this frame
     if (g_renderContext.RenderStart() == VK_ERROR_OUT_OF_DATE_KHR)
         return;
 
-    g_cameraDirector.GetActiveCamera()->UpdateView();
+    m_frustum.Extract(g_renderContext.ModelViewProjectionMatrix);
 
-    // render the quad
-    RenderQuad();
+    // render the quad (if it's in view)
+    if (m_frustum.IntersectsAABB(m_quadBounds.m_min, m_quadBounds.m_max))
+        RenderQuad();
 
     // render debug overlay
     m_debugOverlay->OnRender();
@@ -99,18 +110,24 @@ void Application::OnRender()
 
 void Application::OnUpdate(float dt)
 {
+    g_cameraDirector.GetActiveCamera()->BeginStep();
     UpdateCamera(dt);
-    m_debugOverlay->OnUpdate(dt);
 }
 
 void Application::RenderQuad()
 {
     m_ubo.ModelViewProjectionMatrix = g_renderContext.ModelViewProjectionMatrix;
 
-    void *data;
-    vmaMapMemory(g_renderContext.device.allocator, m_uniformBuffer.allocation, &data);
+    // each frame in flight gets its own copy of the UBO, so the GPU never reads data being overwritten
+    VkDeviceSize offset;
+    void *data = vk::allocateTransient(g_renderContext.activeFrame->transient, sizeof(m_ubo), g_renderContext.device.properties.limits.minUniformBufferOffsetAlignment, &offset);
+    if (!data)
+        return;
+
     memcpy(data, &m_ubo, sizeof(m_ubo));
-    vmaUnmapMemory(g_renderContext.device.allocator, m_uniformBuffer.allocation);
+    m_uboOffset = (uint32_t)offset;
+    // with late latching on, the matrix is rewritten with a fresher camera right before submission (culling above still used this one)
+    g_renderContext.LateLatchMatrix(&static_cast<UniformBufferObject *>(data)->ModelViewProjectionMatrix);
 
     // record new set of command buffers including only visible faces and patches
     Draw();
@@ -118,13 +135,12 @@ void Application::RenderQuad()
 
 void Application::OnTerminate()
 {
-    vkDeviceWaitIdle(g_renderContext.device.logical);
-    vk::destroyPipeline(g_renderContext.device, m_pipeline);
-    vkDestroyDescriptorPool(g_renderContext.device.logical, m_descriptor.pool, nullptr);
-    vk::freeBuffer(g_renderContext.device, m_uniformBuffer);
-    vk::freeBuffer(g_renderContext.device, m_vertexBuffer);
-    vk::freeBuffer(g_renderContext.device, m_indexBuffer);
-    vkDestroyDescriptorSetLayout(g_renderContext.device.logical, m_dsLayout, nullptr);
+    // released by the render context once the GPU is idle
+    m_compiledPipeline.reset();
+    g_renderContext.DeferDestroy(m_descriptor);
+    g_renderContext.DeferDestroy(m_vertexBuffer);
+    g_renderContext.DeferDestroy(m_indexBuffer);
+    m_dsLayout = VK_NULL_HANDLE; // owned by m_descriptor
 
     delete m_debugOverlay;
 }
@@ -149,12 +165,26 @@ void Application::OnKeyPress(KeyCode key)
         break;
     case KEY_F8:
     {
-        int numSamples = (int)g_renderContext.ToggleMSAA();
+        RenderContext::AAMode aaMode = g_renderContext.NextAAMode();
+        // cache lookups returning the pipelines already in use if the sample count is dynamic state
         RebuildPipelines();
         m_debugOverlay->RebuildPipeline();
-        m_debugOverlay->SetMSAASamples(numSamples);
+        m_debugOverlay->SetAAMode(RenderContext::AAModeName(aaMode));
     }
         break;
+    case KEY_F7:
+        g_renderContext.lateLatching = !g_renderContext.lateLatching;
+        m_debugOverlay->SetPresentMode(RenderContext::PresentModeName(g_renderContext.ActivePresentMode()), g_renderContext.MaxQueuedFrames(), g_renderContext.lateLatching);
+        break;
+    case KEY_F9:
+        g_renderContext.NextPresentMode();
+        m_debugOverlay->SetPresentMode(RenderContext::PresentModeName(g_renderContext.ActivePresentMode()), g_renderContext.MaxQueuedFrames(), g_renderContext.lateLatching);
+        break;
+    case KEY_F10:
+        // 1 (lowest latency) up to the number of frames in flight (most CPU/GPU overlap)
+        g_renderContext.SetMaxQueuedFrames(g_renderContext.MaxQueuedFrames() % g_renderContext.FramesInFlight() + 1);
+        m_debugOverlay->SetPresentMode(RenderContext::PresentModeName(g_renderContext.ActivePresentMode()), g_renderContext.MaxQueuedFrames(), g_renderContext.lateLatching);
+        break;
     default:
         break;
     }
@@ -207,7 +237,7 @@ void Application::CreateDescriptorSetLayout()
 {
     VkDescriptorSetLayoutBinding uboLayoutBinding = {};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -232,7 +262,7 @@ void Application::CreateDescriptor(const vk::Texture **textures, vk::Descriptor
 {
     // create descriptor pool
     VkDescriptorPoolSize poolSizes[3];
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     poolSizes[0].descriptorCount = 1;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = 1;
@@ -249,7 +279,7 @@ void Application::CreateDescriptor(const vk::Texture **textures, vk::Descriptor
     VK_VERIFY(vk::createDescriptorSet(g_renderContext.device, descriptor));
     VkDescriptorBufferInfo bufferInfo = {};
     bufferInfo.offset = 0;
-    bufferInfo.buffer = m_uniformBuffer.buffer;
+    bufferInfo.buffer = g_renderContext.TransientBuffer().buffer;
     bufferInfo.range = sizeof(UniformBufferObject);
 
     VkDescriptorImageInfo imageInfo = {};
@@ -262,7 +292,7 @@ void Application::CreateDescriptor(const vk::Texture **textures, vk::Descriptor
     descriptorWrites[0].dstSet = descriptor->set;
     descriptorWrites[0].dstBinding = 0;
     descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[0].descriptorCount = 1;
     descriptorWrites[0].pBufferInfo = &bufferInfo;
     descriptorWrites[0].pImageInfo = nullptr;
@@ -284,21 +314,24 @@ void Application::CreateDescriptor(const vk::Texture **textures, vk::Descriptor
 
 void Application::RebuildPipelines()
 {
-    vk::destroyPipeline(g_renderContext.device, m_pipeline);
-
     // todo: pipeline derivatives https://github.com/SaschaWillems/Vulkan/blob/master/examples/pipelines/pipelines.cpp
     const char *shaders[] = { "res/Basic_vert.spv", "res/Basic_frag.spv" };
-    VK_VERIFY(vk::createPipeline(g_renderContext.device, g_renderContext.swapChain, g_renderContext.activeRenderPass, m_dsLayout, &m_vbInfo, &m_pipeline, shaders));
+    m_compiledPipeline = g_renderContext.CompilePipeline("basic", m_dsLayout, &m_vbInfo, m_pipeline, shaders);
 }
 
 void Application::Draw()
 {
+    // the quad stays hidden while its pipeline for the current AA mode is compiling
+    const vk::Pipeline *pipeline = vk::readyPipeline(m_compiledPipeline);
+    if (!pipeline)
+        return;
+
     // queue standard faces
-    vkCmdBindPipeline(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.pipeline);
+    vk::bindPipeline(g_renderContext.device, g_renderContext.activeCmdBuffer, *pipeline, g_renderContext.activeAttachments.sampleCount);
 
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(g_renderContext.activeCmdBuffer, 0, 1, &m_vertexBuffer.buffer, offsets);
     vkCmdBindIndexBuffer(g_renderContext.activeCmdBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdBindDescriptorSets(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.layout, 0, 1, &m_descriptor.set, 0, nullptr);
+    vkCmdBindDescriptorSets(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, 1, &m_descriptor.set, 1, &m_uboOffset);
     vkCmdDrawIndexed(g_renderContext.activeCmdBuffer, 6, 1, 0, 0, 0);
 }
@@ -5,6 +5,7 @@
 #include "DebugOverlay.hpp"
 #include "InputHandlers.hpp"
 #include "Math.hpp"
+#include "MathFrustum.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/TextureManager.hpp"
 #include "renderer/Ubo.hpp"
@@ -20,8 +21,8 @@ public:
     void OnWindowMinimized(bool minimized);
 
     void OnStart(int argc, char **argv);
-    void OnRender();
-    void OnUpdate(float dt);
+    void OnRender(float frameTime);
+    void OnUpdate(float dt);       // single fixed simulation step
     void OnTerminate();
 
     inline bool Running() const { return m_running; }
@@ -49,13 +50,18 @@ private:
     void Draw();
 
     UniformBufferObject m_ubo;
-    vk::Buffer m_uniformBuffer;
+    uint32_t   m_uboOffset = 0; // dynamic offset of this frame's UBO copy in transient memory
     vk::Buffer m_vertexBuffer;
     vk::Buffer m_indexBuffer;
-    vk::Pipeline   m_pipeline; // used for rendering standard faces
+    vk::Pipeline   m_pipeline; // state used for rendering standard faces
+    vk::PipelineHandle m_compiledPipeline;
     vk::Descriptor m_descriptor;
     GameTexture *m_texture = nullptr;
 
+    // view frustum of the current frame and bounds used to cull the quad against it
+    Math::Frustum m_frustum;
+    Math::AABB    m_quadBounds;
+
     vk::VertexBufferInfo  m_vbInfo;
     VkDescriptorSetLayout m_dsLayout;
 
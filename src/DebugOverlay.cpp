@@ -1,9 +1,15 @@
 #include "DebugOverlay.hpp"
 
-void DebugOverlay::OnUpdate( float dt )
+void DebugOverlay::OnFrameStart( float frameTime, float gpuTime )
 {
     if( m_debugFlags & DEBUG_SHOW_FPS )
-        m_text.OnFrameStart(dt);
+        m_text.OnFrameStart(frameTime, gpuTime);
+}
+
+void DebugOverlay::OnPresent( float presentInterval, float latency )
+{
+    if( m_debugFlags & DEBUG_SHOW_FPS )
+        m_text.OnPresent(presentInterval, latency);
 }
 
 void DebugOverlay::OnRender()
@@ -3,12 +3,15 @@
 
 #include "renderer/Font.hpp"
 #include "InputHandlers.hpp"
+#include <map>
 #include <sstream>
+#include <string>
 
 class OverlayText
 {
 public:
-    OverlayText() : m_numFrames(0), m_numFramesToDraw(1), m_numMSAASamples(1), m_time(0.f)
+    OverlayText() : m_numFrames(0), m_numFramesToDraw(1), m_numGpuFrames(0), m_numPresents(0), m_numLatencies(0), m_maxQueuedFrames(0), m_lateLatching(false), m_aaModeName("off"), m_time(0.f), m_frameTimeToDraw(0.f),
+                    m_gpuTime(0.f), m_gpuTimeToDraw(-1.f), m_presentInterval(0.f), m_presentIntervalToDraw(-1.f), m_latency(0.f), m_latencyToDraw(-1.f)
     {
         m_font = new Font( "res/font.png" );
         m_font->SetScale(Math::Vector2f(2.f, 2.f));
@@ -19,37 +22,106 @@ public:
         delete m_font;
     }
 
-    void OnFrameStart(float dt)
+    void OnFrameStart(float frameTime, float gpuTime)
     {
-        m_time += dt;
+        m_time += frameTime;
         m_numFrames++;
+
+        // negative if the device can't time the frame
+        if (gpuTime >= 0.f)
+        {
+            m_gpuTime += gpuTime;
+            m_numGpuFrames++;
+        }
+    }
+
+    void OnPresent(float presentInterval, float latency)
+    {
+        // both are negative until measured
+        if (presentInterval >= 0.f)
+        {
+            m_presentInterval += presentInterval;
+            m_numPresents++;
+        }
+
+        if (latency >= 0.f)
+        {
+            m_latency += latency;
+            m_numLatencies++;
+        }
     }
 
     void OnRender()
     {
         m_font->RenderStart();
 
-        std::stringstream sstream, sstream2, sstream3;
+        std::stringstream sstream, sstream2, sstream3, sstream4;
         sstream << m_numFramesToDraw << " FPS";
-        sstream2 << (m_numFramesToDraw > 0 ? (1000.f / m_numFramesToDraw) : 0) << " ms";
-        sstream3 << "MSAA:x" << m_numMSAASamples;
+        sstream2 << m_frameTimeToDraw << " ms";
+        sstream3 << "AA: " << m_aaModeName;
+        if (m_gpuTimeToDraw >= 0.f)
+            sstream3 << " GPU " << m_gpuTimeToDraw << " ms";
+        sstream4 << "Present: " << m_presentModeName << " (" << m_maxQueuedFrames << " queued" << (m_lateLatching ? ", late latch)" : ")");
+        if (m_presentIntervalToDraw >= 0.f)
+            sstream4 << " " << m_presentIntervalToDraw << " ms";
+        if (m_latencyToDraw >= 0.f)
+            sstream4 << " latency ~" << m_latencyToDraw << " ms";
 
         m_font->RenderText(sstream.str(), -1.0f, 1.0f );
         m_font->RenderText(sstream2.str(), -1.0f, 0.95f );
         m_font->RenderText(sstream3.str(), -1.0f, 0.90f);
+        m_font->RenderText(sstream4.str(), -1.0f, 0.85f);
+
+        // last measured GPU cost of every mode used so far, for side by side comparison
+        float y = 0.80f;
+        for (const auto &cost : m_aaModeCosts)
+        {
+            std::stringstream costStream;
+            costStream << " " << cost.first << ": " << cost.second << " ms";
+            m_font->RenderText(costStream.str(), -1.0f, y);
+            y -= 0.05f;
+        }
 
         if (m_time > .25f)
         {
-            m_numFramesToDraw = int(m_numFrames / m_time);
+            m_numFramesToDraw = int(m_numFrames / m_time + 0.5f);
+            m_frameTimeToDraw = 1000.f * m_time / m_numFrames; // average over the sampling period
             m_numFrames = 0;
             m_time = 0.f;
+
+            if (m_numGpuFrames > 0)
+            {
+                m_gpuTimeToDraw = m_gpuTime / m_numGpuFrames;
+                m_aaModeCosts[m_aaModeName] = m_gpuTimeToDraw;
+            }
+            m_numGpuFrames = 0;
+            m_gpuTime = 0.f;
+
+            if (m_numPresents > 0)
+                m_presentIntervalToDraw = m_presentInterval / m_numPresents;
+            if (m_numLatencies > 0)
+                m_latencyToDraw = m_latency / m_numLatencies;
+            m_numPresents = 0;
+            m_numLatencies = 0;
+            m_presentInterval = 0.f;
+            m_latency = 0.f;
         }
         m_font->RenderFinish();
     }
 
-    void SetMSAASamples(int samples)
+    void SetAAMode(const char *name)
+    {
+        m_aaModeName = name;
+        // don't attribute timings of the previous mode to the new one
+        m_numGpuFrames = 0;
+        m_gpuTime = 0.f;
+    }
+
+    void SetPresentMode(const char *name, int maxQueuedFrames, bool lateLatching)
     {
-        m_numMSAASamples = samples;
+        m_presentModeName = name;
+        m_maxQueuedFrames = maxQueuedFrames;
+        m_lateLatching = lateLatching;
     }
 
     void RebuildPipeline()
@@ -61,8 +133,22 @@ private:
     Font *m_font;
     int m_numFrames;
     int m_numFramesToDraw;
-    int m_numMSAASamples;
+    int m_numGpuFrames;
+    int m_numPresents;
+    int m_numLatencies;
+    int m_maxQueuedFrames;
+    bool m_lateLatching;
+    std::string m_aaModeName;
+    std::string m_presentModeName;
+    std::map<std::string, float> m_aaModeCosts; // average GPU frame time per AA mode
     float m_time;
+    float m_frameTimeToDraw;
+    float m_gpuTime;
+    float m_gpuTimeToDraw;
+    float m_presentInterval;       // present-to-present, averaged like the frame time
+    float m_presentIntervalToDraw;
+    float m_latency;               // estimated input-to-photon
+    float m_latencyToDraw;
 };
 
 
@@ -79,11 +165,13 @@ public:
     {
     }
 
-    void OnUpdate( float dt );
+    void OnFrameStart( float frameTime, float gpuTime );
+    void OnPresent( float presentInterval, float latency );
     void OnRender();
     void OnKeyPress( KeyCode key );
     bool DebugFlagSet( DebugFlag df ) { return ( m_debugFlags & df ) != 0; }
-    void SetMSAASamples(int samples) { m_text.SetMSAASamples(samples); }
+    void SetAAMode(const char *name) { m_text.SetAAMode(name); }
+    void SetPresentMode(const char *name, int maxQueuedFrames, bool lateLatching) { m_text.SetPresentMode(name, maxQueuedFrames, lateLatching); }
     void RebuildPipeline() { m_text.RebuildPipeline(); }
 private:
     OverlayText m_text;
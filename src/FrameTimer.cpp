@@ -0,0 +1,69 @@
+#include "FrameTimer.hpp"
+
+// SDL_Delay may oversleep by a scheduler tick, so the last stretch before the deadline is spun
+static const double SpinThreshold = 0.002;
+
+FrameTimer::FrameTimer(double stepSize) : m_frequency(SDL_GetPerformanceFrequency()),
+                                          m_stepSize(stepSize)
+{
+}
+
+void FrameTimer::Start()
+{
+    m_lastTime = SDL_GetPerformanceCounter();
+    m_nextFrameTime = m_lastTime + m_frameCapTicks;
+    m_accumulator = 0.0;
+    m_frameTime = 0.0;
+}
+
+int FrameTimer::Advance()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    m_frameTime = Seconds(now - m_lastTime);
+    m_lastTime = now;
+
+    m_accumulator += m_frameTime;
+
+    int numSteps = int(m_accumulator / m_stepSize);
+    if (numSteps > MaxStepsPerFrame)
+    {
+        // drop the time we can't catch up on instead of spiraling into ever longer frames
+        numSteps = MaxStepsPerFrame;
+        m_accumulator = m_stepSize * MaxStepsPerFrame;
+    }
+
+    m_accumulator -= numSteps * m_stepSize;
+    return numSteps;
+}
+
+void FrameTimer::WaitForNextFrame()
+{
+    if (m_frameCapTicks == 0)
+        return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    // frame took longer than the cap - restart pacing from here rather than rushing to catch up
+    if (now >= m_nextFrameTime)
+    {
+        m_nextFrameTime = now + m_frameCapTicks;
+        return;
+    }
+
+    while (now < m_nextFrameTime)
+    {
+        double remaining = Seconds(m_nextFrameTime - now);
+        if (remaining > SpinThreshold)
+            SDL_Delay(Uint32((remaining - SpinThreshold) * 1000.0));
+
+        now = SDL_GetPerformanceCounter();
+    }
+
+    m_nextFrameTime += m_frameCapTicks;
+}
+
+void FrameTimer::SetFrameCap(double maxFps)
+{
+    m_frameCapTicks = maxFps > 0.0 ? Uint64(double(m_frequency) / maxFps) : 0;
+    m_nextFrameTime = SDL_GetPerformanceCounter() + m_frameCapTicks;
+}
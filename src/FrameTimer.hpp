@@ -0,0 +1,45 @@
+#ifndef FRAMETIMER_INCLUDED
+#define FRAMETIMER_INCLUDED
+
+#include <SDL.h>
+
+/*
+ * High resolution frame clock driving a fixed timestep simulation
+ *
+ * Each frame Advance() returns how many fixed steps to simulate, Alpha() then tells
+ * how far the real time is between the last two simulated states (for interpolated rendering).
+ */
+
+class FrameTimer
+{
+public:
+    explicit FrameTimer(double stepSize = 1.0 / 120.0);
+
+    void Start();
+
+    // measure the time since the previous frame and return the number of simulation steps to run
+    int Advance();
+
+    // block until the frame rate cap allows the next frame (no-op if uncapped)
+    void WaitForNextFrame();
+
+    void   SetFrameCap(double maxFps); // 0 disables the cap
+    double StepSize()  const { return m_stepSize; }
+    double FrameTime() const { return m_frameTime; } // real time of the last frame in seconds
+    float  Alpha()     const { return float(m_accumulator / m_stepSize); }
+
+private:
+    static const int MaxStepsPerFrame = 8; // don't try to catch up after long stalls (debugger, window drag)
+
+    double Seconds(Uint64 ticks) const { return double(ticks) / double(m_frequency); }
+
+    Uint64 m_frequency;
+    Uint64 m_lastTime = 0;
+    Uint64 m_frameCapTicks = 0;
+    Uint64 m_nextFrameTime = 0;
+    double m_stepSize;
+    double m_accumulator = 0.0;
+    double m_frameTime = 0.0;
+};
+
+#endif
@@ -117,6 +117,16 @@ KeyCode SDLKeyToKeyCode(SDL_Keycode key)
 }
 
 
+void processMouseMotion()
+{
+    SDL_Event event;
+
+    // everything else stays queued for the next processEvents()
+    SDL_PumpEvents();
+    while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION) > 0)
+        g_application.OnMouseMove(event.motion.x, event.motion.y);
+}
+
 void processEvents()
 {
     SDL_Event event;
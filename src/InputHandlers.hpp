@@ -66,5 +66,7 @@ enum KeyCode
 // handler functions
 KeyCode SDLKeyToKeyCode(SDL_Keycode key);
 void processEvents();
+// mouse motion only - safe to call while a frame is being recorded (late latching)
+void processMouseMotion();
 
 #endif
\ No newline at end of file
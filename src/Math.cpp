@@ -1,109 +1,281 @@
 #include "Math.hpp"
+#include "MathSIMD.hpp"
+#include <type_traits>
 
 namespace Math
 {
+    static_assert(sizeof(Vector4f) == 4 * sizeof(float), "Vector4f must be tightly packed for SIMD stores");
+    static_assert(sizeof(Quaternion) == 4 * sizeof(float), "Quaternion must be tightly packed for SIMD loads");
+    static_assert(std::is_trivially_copyable<Vector3f>::value && std::is_trivially_copyable<Quaternion>::value, "Vectors and quaternions are copied in bulk");
+    static_assert(VulkanClipCorrection[5] == -1.f && VulkanClipCorrection[14] == 0.5f, "Vulkan clip correction must be a compile-time constant");
 
 /*
  * 4x4 Matrix
  */
 
-    void Matrix4f::Identity()
+    void Matrix4f::Transpose()
     {
-        m_m[0] = 1.f;
-        m_m[1] = 0.f;
-        m_m[2] = 0.f;
-        m_m[3] = 0.f;
+#ifdef MATH_SIMD_SSE
+        __m128 r0 = _mm_load_ps(&m_m[0]);
+        __m128 r1 = _mm_load_ps(&m_m[4]);
+        __m128 r2 = _mm_load_ps(&m_m[8]);
+        __m128 r3 = _mm_load_ps(&m_m[12]);
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_store_ps(&m_m[0],  r0);
+        _mm_store_ps(&m_m[4],  r1);
+        _mm_store_ps(&m_m[8],  r2);
+        _mm_store_ps(&m_m[12], r3);
+#else
+        Scalar::Transpose(*this);
+#endif
+    }
 
-        m_m[4] = 0.f;
-        m_m[5] = 1.f;
-        m_m[6] = 0.f;
-        m_m[7] = 0.f;
+    Vector3f Matrix4f::operator*(const Vector3f &v) const
+    {
+        // point (w = 1) in the column vector layout, the xyz of matrix * Vector4f(v, 1)
+        return Vector3f(v.m_x * m_m[0] + v.m_y * m_m[4] + v.m_z * m_m[8]  + 1.f * m_m[12],
+                        v.m_x * m_m[1] + v.m_y * m_m[5] + v.m_z * m_m[9]  + 1.f * m_m[13],
+                        v.m_x * m_m[2] + v.m_y * m_m[6] + v.m_z * m_m[10] + 1.f * m_m[14]);
+    }
 
-        m_m[8]  = 0.f;
-        m_m[9]  = 0.f;
-        m_m[10] = 1.f;
-        m_m[11] = 0.f;
+#ifdef MATH_SIMD_SSE
+    // matrices are laid out for column vectors (translation in m[12..14], see MakeView) - column j is m[4j..4j+3],
+    // so the rows can be loaded as they are and a vector is transformed as x * c0 + y * c1 + z * c2 + w * c3
+    static inline void loadColumns(const Matrix4f &m, __m128 &c0, __m128 &c1, __m128 &c2, __m128 &c3)
+    {
+        c0 = _mm_load_ps(&m.m_m[0]);
+        c1 = _mm_load_ps(&m.m_m[4]);
+        c2 = _mm_load_ps(&m.m_m[8]);
+        c3 = _mm_load_ps(&m.m_m[12]);
+    }
 
-        m_m[12] = 0.f;
-        m_m[13] = 0.f;
-        m_m[14] = 0.f;
-        m_m[15] = 1.f;
+    // operation order matches the scalar code, so results are identical unless FMA is enabled
+    static inline __m128 transformVector(const __m128 &c0, const __m128 &c1, const __m128 &c2, const __m128 &c3, float x, float y, float z, float w)
+    {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(x), c0);
+        r = Simd::MulAdd(_mm_set1_ps(y), c1, r);
+        r = Simd::MulAdd(_mm_set1_ps(z), c2, r);
+        return Simd::MulAdd(_mm_set1_ps(w), c3, r);
     }
 
-    void Matrix4f::Zero()
+    // r = a * b (r may alias a or b)
+    static inline void multiplyMatrix(const float *a, const float *b, float *r)
     {
-        for (int i = 0; i < 16; i++)
+        __m128 b0 = _mm_load_ps(b);
+        __m128 b1 = _mm_load_ps(b + 4);
+        __m128 b2 = _mm_load_ps(b + 8);
+        __m128 b3 = _mm_load_ps(b + 12);
+#ifdef MATH_SIMD_AVX
+        // two result rows per iteration - each 128-bit lane holds one row
+        __m256 bb0 = Simd::Duplicate(b0);
+        __m256 bb1 = Simd::Duplicate(b1);
+        __m256 bb2 = Simd::Duplicate(b2);
+        __m256 bb3 = Simd::Duplicate(b3);
+
+        for (int i = 0; i < 16; i += 8)
+        {
+            __m256 rows = _mm256_loadu_ps(a + i);
+            __m256 res  = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x00), bb0);
+            res = Simd::MulAdd(_mm256_shuffle_ps(rows, rows, 0x55), bb1, res);
+            res = Simd::MulAdd(_mm256_shuffle_ps(rows, rows, 0xAA), bb2, res);
+            res = Simd::MulAdd(_mm256_shuffle_ps(rows, rows, 0xFF), bb3, res);
+            _mm256_storeu_ps(r + i, res);
+        }
+#else
+        for (int i = 0; i < 16; i += 4)
         {
-            m_m[i] = 0.0f;
+            __m128 row = _mm_load_ps(a + i);
+            __m128 res = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), b0);
+            res = Simd::MulAdd(_mm_shuffle_ps(row, row, 0x55), b1, res);
+            res = Simd::MulAdd(_mm_shuffle_ps(row, row, 0xAA), b2, res);
+            res = Simd::MulAdd(_mm_shuffle_ps(row, row, 0xFF), b3, res);
+            _mm_store_ps(r + i, res);
         }
+#endif
     }
+#endif
 
-    void Matrix4f::One()
+    Vector4f Matrix4f::operator*(const Vector4f &v) const
     {
-        for (int i = 0; i < 16; i++)
-        {
-            m_m[i] = 1.0f;
-        }
+#ifdef MATH_SIMD_SSE
+        __m128 c0, c1, c2, c3;
+        loadColumns(*this, c0, c1, c2, c3);
+
+        Vector4f result;
+        _mm_storeu_ps(&result.m_x, transformVector(c0, c1, c2, c3, v.m_x, v.m_y, v.m_z, v.m_w));
+        return result;
+#else
+        return Scalar::Transform(*this, v);
+#endif
     }
 
-    void Matrix4f::Transpose()
+    Matrix4f Matrix4f::operator*(const Matrix4f &m2) const
     {
-        Matrix4f temp;
+#ifdef MATH_SIMD_SSE
+        Matrix4f result;
+        multiplyMatrix(m_m, m2.m_m, result.m_m);
+        return result;
+#else
+        return Scalar::Multiply(*this, m2);
+#endif
+    }
 
-        for (int i = 0; i < 16; i++)
-            temp[i] = m_m[i];
+#ifdef MATH_SIMD_SSE
+    // 2x2 matrix helpers for the block-wise inverse - each register holds a row-major 2x2 matrix
+    static inline __m128 mat2Mul(__m128 a, __m128 b) // a * b
+    {
+        return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+    }
 
-        for (int i = 0; i < 4; i++)
-        {
-            for (int j = 0; j < 4; j++)
-            {
-                m_m[i * 4 + j] = temp[i + j * 4];
-            }
-        }
+    static inline __m128 mat2AdjMul(__m128 a, __m128 b) // adj(a) * b
+    {
+        return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
     }
 
-    void Matrix4f::Invert()
+    static inline __m128 mat2MulAdj(__m128 a, __m128 b) // a * adj(b)
     {
-        // todo
+        return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
     }
 
-    Vector3f Matrix4f::operator*(const Vector3f &v) const
+    // general inverse by 2x2 blocks: M = |A B|, nothing is written to r if M is singular (r may alias m)
+    //                                    |C D|
+    static inline bool invertMatrix(const float *m, float *r)
     {
-        return Vector3f(m_m[0] * v.m_x + m_m[1] * v.m_y + m_m[2]  * v.m_z + m_m[3]  * 1.f,
-                        m_m[4] * v.m_x + m_m[5] * v.m_y + m_m[6]  * v.m_z + m_m[7]  * 1.f,
-                        m_m[8] * v.m_x + m_m[9] * v.m_y + m_m[10] * v.m_z + m_m[11] * 1.f);
+        __m128 r0 = _mm_load_ps(m);
+        __m128 r1 = _mm_load_ps(m + 4);
+        __m128 r2 = _mm_load_ps(m + 8);
+        __m128 r3 = _mm_load_ps(m + 12);
+
+        __m128 A = _mm_movelh_ps(r0, r1);
+        __m128 B = _mm_movehl_ps(r1, r0);
+        __m128 C = _mm_movelh_ps(r2, r3);
+        __m128 D = _mm_movehl_ps(r3, r2);
+
+        // (|A|, |B|, |C|, |D|)
+        __m128 detSub = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+                                   _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+        __m128 detA = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 detB = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 detC = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 detD = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128 DC = mat2AdjMul(D, C);
+        __m128 AB = mat2AdjMul(A, B);
+
+        // adjugates of the result blocks
+        __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, DC));
+        __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, AB));
+        __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, AB));
+        __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, DC));
+
+        // |M| = |A||D| + |B||C| - tr(adj(A)B * adj(D)C)
+        __m128 tr = _mm_mul_ps(AB, _mm_shuffle_ps(DC, DC, _MM_SHUFFLE(3, 1, 2, 0)));
+        tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+        tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        __m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+        if (_mm_cvtss_f32(detM) == 0.f)
+            return false;
+
+        __m128 rDetM = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), detM);
+        X = _mm_mul_ps(X, rDetM);
+        Y = _mm_mul_ps(Y, rDetM);
+        Z = _mm_mul_ps(Z, rDetM);
+        W = _mm_mul_ps(W, rDetM);
+
+        // the final shuffle also applies the adjugate swap of each block
+        _mm_store_ps(r,      _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(r + 4,  _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)));
+        _mm_store_ps(r + 8,  _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(r + 12, _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2)));
+        return true;
     }
 
-    Vector4f Matrix4f::operator*(const Vector4f &v) const
+    // store inverted 3x3 rows i0-i2 (w = 0) followed by the inverted translation -t * R^-1
+    static inline void storeAffineInverse(__m128 i0, __m128 i1, __m128 i2, __m128 t, float *r)
     {
-        return Vector4f(m_m[0]  * v.m_x + m_m[1]  * v.m_y + m_m[2]  * v.m_z + m_m[3]  * 1.f,
-                        m_m[4]  * v.m_x + m_m[5]  * v.m_y + m_m[6]  * v.m_z + m_m[7]  * 1.f,
-                        m_m[8]  * v.m_x + m_m[9]  * v.m_y + m_m[10] * v.m_z + m_m[11] * 1.f,
-                        m_m[12] * v.m_x + m_m[13] * v.m_y + m_m[14] * v.m_z + m_m[15] * 1.f);
+        __m128 it = _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)), i0);
+        it = Simd::MulAdd(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), i1, it);
+        it = Simd::MulAdd(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), i2, it);
+
+        _mm_store_ps(r,      i0);
+        _mm_store_ps(r + 4,  i1);
+        _mm_store_ps(r + 8,  i2);
+        _mm_store_ps(r + 12, _mm_sub_ps(_mm_setr_ps(0.f, 0.f, 0.f, 1.f), it));
     }
 
-    Matrix4f Matrix4f::operator*(const Matrix4f &m2) const
+    static inline __m128 loadXYZ(const float *m)
+    {
+        return _mm_and_ps(_mm_load_ps(m), _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+    }
+
+    // the cofactor rows c0-c2 of the upper 3x3 are its inverse-transpose scaled by the determinant
+    static inline bool cofactors3x3(const float *m, __m128 &c0, __m128 &c1, __m128 &c2)
+    {
+        __m128 r0 = loadXYZ(m);
+        __m128 r1 = loadXYZ(m + 4);
+        __m128 r2 = loadXYZ(m + 8);
+
+        c0 = Simd::Cross3(r1, r2);
+        c1 = Simd::Cross3(r2, r0);
+        c2 = Simd::Cross3(r0, r1);
+
+        __m128 det = Simd::Dot3(r0, c0);
+        if (_mm_cvtss_f32(det) == 0.f)
+            return false;
+
+        __m128 rDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+        c0 = _mm_mul_ps(c0, rDet);
+        c1 = _mm_mul_ps(c1, rDet);
+        c2 = _mm_mul_ps(c2, rDet);
+        return true;
+    }
+#endif
+
+    bool Matrix4f::Invert()
     {
-        return Matrix4f(m_m[0] * m2[0] + m_m[1] * m2[4] + m_m[2] * m2[8]  + m_m[3] * m2[12],
-                        m_m[0] * m2[1] + m_m[1] * m2[5] + m_m[2] * m2[9]  + m_m[3] * m2[13],
-                        m_m[0] * m2[2] + m_m[1] * m2[6] + m_m[2] * m2[10] + m_m[3] * m2[14],
-                        m_m[0] * m2[3] + m_m[1] * m2[7] + m_m[2] * m2[11] + m_m[3] * m2[15], 
-                        
-                        m_m[4] * m2[0] + m_m[5] * m2[4] + m_m[6] * m2[8]  + m_m[7] * m2[12],
-                        m_m[4] * m2[1] + m_m[5] * m2[5] + m_m[6] * m2[9]  + m_m[7] * m2[13],
-                        m_m[4] * m2[2] + m_m[5] * m2[6] + m_m[6] * m2[10] + m_m[7] * m2[14],
-                        m_m[4] * m2[3] + m_m[5] * m2[7] + m_m[6] * m2[11] + m_m[7] * m2[15],
+#ifdef MATH_SIMD_SSE
+        return invertMatrix(m_m, m_m);
+#else
+        return Scalar::Invert(*this);
+#endif
+    }
 
-                        m_m[8] * m2[0] + m_m[9] * m2[4] + m_m[10] * m2[8]  + m_m[11] * m2[12],
-                        m_m[8] * m2[1] + m_m[9] * m2[5] + m_m[10] * m2[9]  + m_m[11] * m2[13],
-                        m_m[8] * m2[2] + m_m[9] * m2[6] + m_m[10] * m2[10] + m_m[11] * m2[14],
-                        m_m[8] * m2[3] + m_m[9] * m2[7] + m_m[10] * m2[11] + m_m[11] * m2[15],
+    bool Matrix4f::InvertAffine()
+    {
+#ifdef MATH_SIMD_SSE
+        __m128 c0, c1, c2;
+        if (!cofactors3x3(m_m, c0, c1, c2))
+            return false;
+
+        __m128 c3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        storeAffineInverse(c0, c1, c2, loadXYZ(&m_m[12]), m_m);
+        return true;
+#else
+        return Scalar::InvertAffine(*this);
+#endif
+    }
 
-                        m_m[12] * m2[0] + m_m[13] * m2[4] + m_m[14] * m2[8]  + m_m[15] * m2[12],
-                        m_m[12] * m2[1] + m_m[13] * m2[5] + m_m[14] * m2[9]  + m_m[15] * m2[13],
-                        m_m[12] * m2[2] + m_m[13] * m2[6] + m_m[14] * m2[10] + m_m[15] * m2[14],
-                        m_m[12] * m2[3] + m_m[13] * m2[7] + m_m[14] * m2[11] + m_m[15] * m2[15]
-                        );
+    void Matrix4f::InvertOrthonormal()
+    {
+#ifdef MATH_SIMD_SSE
+        __m128 r0 = loadXYZ(&m_m[0]);
+        __m128 r1 = loadXYZ(&m_m[4]);
+        __m128 r2 = loadXYZ(&m_m[8]);
+        __m128 r3 = _mm_setzero_ps();
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        storeAffineInverse(r0, r1, r2, loadXYZ(&m_m[12]), m_m);
+#else
+        Scalar::InvertOrthonormal(*this);
+#endif
     }
 
 /*
@@ -118,204 +290,359 @@ namespace Math
         m_z /= l;
     }
 
-    void Vector3f::QuickNormalize()
+    void Vector3f::QuickNormalize(RsqrtAccuracy accuracy)
     {
-        float l = QuickInverseSqrt( m_x*m_x + m_y*m_y + m_z*m_z );
+        float l2 = m_x*m_x + m_y*m_y + m_z*m_z;
+        if (l2 == 0.0f) return;
+        float l = QuickInverseSqrt( l2, accuracy );
         m_x *= l;
         m_y *= l;
         m_z *= l;
     }
 
-    Vector3f Vector3f::CrossProduct(const Vector3f &v2) const
+/*
+ *  Quaternion
+ */
+    void Quaternion::Normalize()
     {
-        return Vector3f( m_y*v2.m_z - m_z*v2.m_y,
-                         m_z*v2.m_x - m_x*v2.m_z,
-                         m_x*v2.m_y - m_y*v2.m_x );
+        float l = sqrtf( m_x*m_x + m_y*m_y + m_z*m_z + m_w*m_w );
+        m_x /= l;
+        m_y /= l;
+        m_z /= l;
+        m_w /= l;
     }
 
-    float Vector3f::DotProduct(const Vector3f &v2) const
+    void Quaternion::QuickNormalize(RsqrtAccuracy accuracy)
     {
-        return m_x*v2.m_x + m_y*v2.m_y + m_z*v2.m_z;
+        float l2 = m_x*m_x + m_y*m_y + m_z*m_z + m_w*m_w;
+        if (l2 == 0.0f) return;
+        float l = QuickInverseSqrt( l2, accuracy );
+        m_x *= l;
+        m_y *= l;
+        m_z *= l;
+        m_w *= l;
     }
 
-    Vector3f Vector3f::operator+(const Vector3f &v2) const 
+    Matrix4f Quaternion::ToMatrix() const
     {
-        return Vector3f( m_x + v2.m_x,
-                         m_y + v2.m_y,
-                         m_z + v2.m_z );;
+        float xx = m_x * m_x, yy = m_y * m_y, zz = m_z * m_z;
+        float xy = m_x * m_y, xz = m_x * m_z, yz = m_y * m_z;
+        float wx = m_w * m_x, wy = m_w * m_y, wz = m_w * m_z;
+
+        return Matrix4f(1.f - 2.f * (yy + zz), 2.f * (xy + wz),       2.f * (xz - wy),       0.f,
+                        2.f * (xy - wz),       1.f - 2.f * (xx + zz), 2.f * (yz + wx),       0.f,
+                        2.f * (xz + wy),       2.f * (yz - wx),       1.f - 2.f * (xx + yy), 0.f,
+                        0.f,                   0.f,                   0.f,                   1.f);
     }
 
-    Vector3f Vector3f::operator-(const Vector3f &v2) const
+    Quaternion Nlerp(const Quaternion &q1, const Quaternion &q2, float t)
     {
-        return Vector3f( m_x-v2.m_x,
-                         m_y-v2.m_y,
-                         m_z-v2.m_z );
+        float dot = q1.m_x * q2.m_x + q1.m_y * q2.m_y + q1.m_z * q2.m_z + q1.m_w * q2.m_w;
+        // q and -q are the same rotation - flip q2 to take the shorter arc
+        float t2 = dot < 0.f ? -t : t;
+        float t1 = 1.f - t;
+
+        Quaternion result(q1.m_x * t1 + q2.m_x * t2,
+                          q1.m_y * t1 + q2.m_y * t2,
+                          q1.m_z * t1 + q2.m_z * t2,
+                          q1.m_w * t1 + q2.m_w * t2);
+        result.Normalize();
+        return result;
     }
 
-    Vector3f Vector3f::operator*( float r ) const
+    Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t)
     {
-        return Vector3f( m_x*r,
-                         m_y*r,
-                         m_z*r );
+        float cosTheta = q1.m_x * q2.m_x + q1.m_y * q2.m_y + q1.m_z * q2.m_z + q1.m_w * q2.m_w;
+        float sign = cosTheta < 0.f ? -1.f : 1.f;
+        cosTheta *= sign;
+
+        // nearly identical rotations - sin(theta) is too small to divide by
+        if (cosTheta > 0.9995f)
+            return Nlerp(q1, q2, t);
+
+        float theta = acosf(cosTheta);
+        float invSinTheta = 1.f / sinf(theta);
+        float t1 = sinf((1.f - t) * theta) * invSinTheta;
+        float t2 = sinf(t * theta) * invSinTheta * sign;
+
+        return Quaternion(q1.m_x * t1 + q2.m_x * t2,
+                          q1.m_y * t1 + q2.m_y * t2,
+                          q1.m_z * t1 + q2.m_z * t2,
+                          q1.m_w * t1 + q2.m_w * t2);
     }
 
-    Vector3f Vector3f::operator/(float r) const
+#ifdef MATH_SIMD_SSE
+    // 4 rotations at once - same formula as Quaternion::operator*(Vector3f)
+    static inline void rotateLanes(__m128 ux, __m128 uy, __m128 uz, __m128 w, __m128 &vx, __m128 &vy, __m128 &vz)
     {
-        return Vector3f(m_x/r,
-                        m_y/r,
-                        m_z/r);
+        __m128 two = _mm_set1_ps(2.f);
+        __m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)));
+        __m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)));
+        __m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)));
+
+        vx = _mm_add_ps(Simd::MulAdd(w, tx, vx), _mm_sub_ps(_mm_mul_ps(uy, tz), _mm_mul_ps(uz, ty)));
+        vy = _mm_add_ps(Simd::MulAdd(w, ty, vy), _mm_sub_ps(_mm_mul_ps(uz, tx), _mm_mul_ps(ux, tz)));
+        vz = _mm_add_ps(Simd::MulAdd(w, tz, vz), _mm_sub_ps(_mm_mul_ps(ux, ty), _mm_mul_ps(uy, tx)));
     }
 
-/*
- *  Quaternion
- */
-    Quaternion Quaternion::GetConjugate() const
+    static inline void loadVectors(const Vector3f *v, __m128 &x, __m128 &y, __m128 &z)
     {
-        return Quaternion( -m_x, -m_y, -m_z, m_w);
+        x = _mm_setr_ps(v[0].m_x, v[1].m_x, v[2].m_x, v[3].m_x);
+        y = _mm_setr_ps(v[0].m_y, v[1].m_y, v[2].m_y, v[3].m_y);
+        z = _mm_setr_ps(v[0].m_z, v[1].m_z, v[2].m_z, v[3].m_z);
     }
 
-    void Quaternion::Normalize()
+    static inline void storeVectors(Vector3f *v, __m128 x, __m128 y, __m128 z)
     {
-        float l = sqrtf( m_x*m_x + m_y*m_y + m_z*m_z + m_w*m_w );
-        m_x /= l;
-        m_y /= l;
-        m_z /= l;
-        m_w /= l;
+        alignas(16) float xs[4], ys[4], zs[4];
+        _mm_store_ps(xs, x);
+        _mm_store_ps(ys, y);
+        _mm_store_ps(zs, z);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            v[i].m_x = xs[i];
+            v[i].m_y = ys[i];
+            v[i].m_z = zs[i];
+        }
     }
+#endif
 
-    void Quaternion::QuickNormalize()
+    void RotateVectors(const Quaternion &q, const Vector3f *in, Vector3f *out, size_t n)
     {
-        float l = QuickInverseSqrt( m_x*m_x + m_y*m_y + m_z*m_z + m_w*m_w );
-        m_x *= l;
-        m_y *= l;
-        m_z *= l;
-        m_w *= l;
+        size_t i = 0;
+#ifdef MATH_SIMD_SSE
+        __m128 ux = _mm_set1_ps(q.m_x);
+        __m128 uy = _mm_set1_ps(q.m_y);
+        __m128 uz = _mm_set1_ps(q.m_z);
+        __m128 w  = _mm_set1_ps(q.m_w);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 x, y, z;
+            loadVectors(&in[i], x, y, z);
+            rotateLanes(ux, uy, uz, w, x, y, z);
+            storeVectors(&out[i], x, y, z);
+        }
+#endif
+        for (; i < n; ++i)
+            out[i] = q * in[i];
     }
 
-    Quaternion Quaternion::operator*(const Quaternion &q2) const
+    void RotateVectors(const Quaternion *q, const Vector3f *in, Vector3f *out, size_t n)
     {
-        return Quaternion( m_w*q2.m_x + m_x*q2.m_w + m_y*q2.m_z - m_z*q2.m_y,
-                           m_w*q2.m_y - m_x*q2.m_z + m_y*q2.m_w + m_z*q2.m_x,
-                           m_w*q2.m_z + m_x*q2.m_y - m_y*q2.m_x + m_z*q2.m_w,
-                           m_w*q2.m_w - m_x*q2.m_x - m_y*q2.m_y - m_z*q2.m_z );
+        size_t i = 0;
+#ifdef MATH_SIMD_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            // quaternions are 4 packed floats, so a transpose gives x, y, z and w lanes directly
+            __m128 ux = _mm_loadu_ps(&q[i].m_x);
+            __m128 uy = _mm_loadu_ps(&q[i + 1].m_x);
+            __m128 uz = _mm_loadu_ps(&q[i + 2].m_x);
+            __m128 w  = _mm_loadu_ps(&q[i + 3].m_x);
+            _MM_TRANSPOSE4_PS(ux, uy, uz, w);
+
+            __m128 x, y, z;
+            loadVectors(&in[i], x, y, z);
+            rotateLanes(ux, uy, uz, w, x, y, z);
+            storeVectors(&out[i], x, y, z);
+        }
+#endif
+        for (; i < n; ++i)
+            out[i] = q[i] * in[i];
     }
 
+/*
+ * General purpose functions
+ */
+    float QuickInverseSqrt( float number, RsqrtAccuracy accuracy )
+    {
+        return Simd::InverseSqrt(number, accuracy);
+    }
 
-    Vector3f Quaternion::operator*(const Vector3f &vec) const
+    void InverseSqrt(const float *in, float *out, size_t n, RsqrtAccuracy accuracy)
     {
-        Vector3f vn(vec);
-        vn.QuickNormalize();
+        size_t i = 0;
+#ifdef MATH_SIMD_AVX
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(out + i, Simd::InverseSqrt(_mm256_loadu_ps(in + i), accuracy));
+#endif
+#ifdef MATH_SIMD_SSE
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(out + i, Simd::InverseSqrt(_mm_loadu_ps(in + i), accuracy));
+#endif
+        for (; i < n; ++i)
+            out[i] = Simd::InverseSqrt(in[i], accuracy);
+    }
 
-        Quaternion vecQuat( vn.m_x,
-                            vn.m_y,
-                            vn.m_z,
-                            0.0f );
+    void NormalizeVectors(Vector3f *v, size_t n, RsqrtAccuracy accuracy)
+    {
+        size_t i = 0;
+#ifdef MATH_SIMD_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 x, y, z;
+            loadVectors(&v[i], x, y, z);
 
-        Quaternion resQuat( vecQuat * GetConjugate() );
-        resQuat = *this * resQuat;
+            __m128 len2 = Simd::MulAdd(z, z, Simd::MulAdd(y, y, _mm_mul_ps(x, x)));
+            // masking the factor to 0 keeps zero-length vectors at zero instead of 0 * inf
+            __m128 invLen = _mm_and_ps(_mm_cmpgt_ps(len2, _mm_setzero_ps()), Simd::InverseSqrt(len2, accuracy));
+            storeVectors(&v[i], _mm_mul_ps(x, invLen), _mm_mul_ps(y, invLen), _mm_mul_ps(z, invLen));
+        }
+#endif
+        for (; i < n; ++i)
+            v[i].QuickNormalize(accuracy);
+    }
 
-        return Vector3f(resQuat.m_x, resQuat.m_y, resQuat.m_z);
+    void NormalizeQuaternions(Quaternion *q, size_t n, RsqrtAccuracy accuracy)
+    {
+        size_t i = 0;
+#ifdef MATH_SIMD_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&q[i].m_x);
+            __m128 y = _mm_loadu_ps(&q[i + 1].m_x);
+            __m128 z = _mm_loadu_ps(&q[i + 2].m_x);
+            __m128 w = _mm_loadu_ps(&q[i + 3].m_x);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+
+            __m128 len2 = Simd::MulAdd(w, w, Simd::MulAdd(z, z, Simd::MulAdd(y, y, _mm_mul_ps(x, x))));
+            __m128 invLen = _mm_and_ps(_mm_cmpgt_ps(len2, _mm_setzero_ps()), Simd::InverseSqrt(len2, accuracy));
+            x = _mm_mul_ps(x, invLen);
+            y = _mm_mul_ps(y, invLen);
+            z = _mm_mul_ps(z, invLen);
+            w = _mm_mul_ps(w, invLen);
+
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&q[i].m_x, x);
+            _mm_storeu_ps(&q[i + 1].m_x, y);
+            _mm_storeu_ps(&q[i + 2].m_x, z);
+            _mm_storeu_ps(&q[i + 3].m_x, w);
+        }
+#endif
+        for (; i < n; ++i)
+            q[i].QuickNormalize(accuracy);
     }
 
+    void TransformPoints(const Matrix4f &matrix, const Vector3f *in, Vector4f *out, size_t n)
+    {
+#ifdef MATH_SIMD_SSE
+        __m128 c0, c1, c2, c3;
+        loadColumns(matrix, c0, c1, c2, c3);
+        size_t i = 0;
+#ifdef MATH_SIMD_AVX
+        __m256 cc0 = Simd::Duplicate(c0);
+        __m256 cc1 = Simd::Duplicate(c1);
+        __m256 cc2 = Simd::Duplicate(c2);
+        __m256 cc3 = Simd::Duplicate(c3);
+
+        // two points per iteration - Vector4f is tightly packed, so both results go out in a single store
+        for (; i + 2 <= n; i += 2)
+        {
+            __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].m_x)), _mm_set1_ps(in[i + 1].m_x), 1);
+            __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].m_y)), _mm_set1_ps(in[i + 1].m_y), 1);
+            __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].m_z)), _mm_set1_ps(in[i + 1].m_z), 1);
+
+            __m256 r = _mm256_mul_ps(x, cc0);
+            r = Simd::MulAdd(y, cc1, r);
+            r = Simd::MulAdd(z, cc2, r);
+            _mm256_storeu_ps(&out[i].m_x, Simd::MulAdd(_mm256_set1_ps(1.f), cc3, r));
+        }
+#endif
+        for (; i < n; ++i)
+            _mm_storeu_ps(&out[i].m_x, transformVector(c0, c1, c2, c3, in[i].m_x, in[i].m_y, in[i].m_z, 1.f));
+#else
+        Scalar::TransformPoints(matrix, in, out, n);
+#endif
+    }
 
-/*
- * General purpose functions
- */
-    float QuickInverseSqrt( float number )
+    void MultiplyMatrices(const Matrix4f *a, const Matrix4f &b, Matrix4f *out, size_t n)
     {
-        long i;
-        float x2, y;
+        for (size_t i = 0; i < n; ++i)
+        {
+#ifdef MATH_SIMD_SSE
+            multiplyMatrix(a[i].m_m, b.m_m, out[i].m_m);
+#else
+            out[i] = Scalar::Multiply(a[i], b);
+#endif
+        }
+    }
 
-        x2 = number * 0.5F;
-        y  = number;
-        i  = * ( long * ) &y;
-        i  = 0x5f3759df - ( i >> 1 );
-        y  = * ( float * ) &i;
-        y  = y * ( 1.5f - ( x2 * y * y ) );   // 1st iteration
-        y  = y * ( 1.5f - ( x2 * y * y ) );   // 2nd iteration
+    bool MakeNormalMatrix(Matrix4f &normalMatrix, const Matrix4f &model)
+    {
+#ifdef MATH_SIMD_SSE
+        __m128 c0, c1, c2;
+        if (!cofactors3x3(model.m_m, c0, c1, c2))
+        {
+            normalMatrix.Identity();
+            return false;
+        }
 
-        return y;
+        _mm_store_ps(&normalMatrix.m_m[0],  c0);
+        _mm_store_ps(&normalMatrix.m_m[4],  c1);
+        _mm_store_ps(&normalMatrix.m_m[8],  c2);
+        _mm_store_ps(&normalMatrix.m_m[12], _mm_setr_ps(0.f, 0.f, 0.f, 1.f));
+        return true;
+#else
+        return Scalar::MakeNormalMatrix(normalMatrix, model);
+#endif
     }
 
-    int PointPlanePos(float normalX, float normalY, float normalZ, float intercept, const Math::Vector3f &point)
+    size_t InvertMatrices(const Matrix4f *in, Matrix4f *out, size_t n)
     {
-        float distance = point.m_x * normalX + point.m_y * normalY + point.m_z * normalZ - intercept;
+        size_t singular = 0;
 
-        if(distance >= 0.0f)
-            return PointInFrontOfPlane;
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = in[i];
+            if (!out[i].Invert())
+                singular++;
+        }
 
-        return PointBehindPlane; 
+        return singular;
     }
 
-    void Translate(Matrix4f &matrix, float x, float y, float z)
+    size_t InvertAffineMatrices(const Matrix4f *in, Matrix4f *out, size_t n)
     {
-        float tx = x;
-        float ty = y;
-        float tz = z;
-        float tw = 1.f;
+        size_t singular = 0;
 
-        float t1 = matrix[0] * tx + matrix[4] * ty + matrix[8]  * tz + matrix[12] * tw;
-        float t2 = matrix[1] * tx + matrix[5] * ty + matrix[9]  * tz + matrix[13] * tw;
-        float t3 = matrix[2] * tx + matrix[6] * ty + matrix[10] * tz + matrix[14] * tw;
-        float t4 = matrix[3] * tx + matrix[7] * ty + matrix[11] * tz + matrix[15] * tw;
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = in[i];
+            if (!out[i].InvertAffine())
+                singular++;
+        }
 
-        matrix[12] = t1;
-        matrix[13] = t2;
-        matrix[14] = t3;
-        matrix[15] = t4;
+        return singular;
     }
 
-    void Scale(Matrix4f &matrix, float x, float y, float z)
+    size_t MakeNormalMatrices(const Matrix4f *model, Matrix4f *out, size_t n)
     {
-        float sx = x;
-        float sy = y;
-        float sz = z;
-        float sw = 1.f;
+        size_t singular = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!MakeNormalMatrix(out[i], model[i]))
+                singular++;
+        }
 
-        matrix[0]  *= sx;
-        matrix[1]  *= sx;
-        matrix[2]  *= sx;
-        matrix[3]  *= sx;
-        matrix[4]  *= sy;
-        matrix[5]  *= sy;
-        matrix[6]  *= sy;
-        matrix[7]  *= sy;
-        matrix[8]  *= sz;
-        matrix[9]  *= sz;
-        matrix[10] *= sz;
-        matrix[11] *= sz;
-        matrix[12] *= sw;
-        matrix[13] *= sw;
-        matrix[14] *= sw;
-        matrix[15] *= sw;
+        return singular;
     }
 
-    // create perspective projection matrix
-    void MakePerspective(Math::Matrix4f &matrix, float fov, float scrRatio, float nearPlane, float farPlane)
+    int PointPlanePos(float normalX, float normalY, float normalZ, float intercept, const Math::Vector3f &point)
     {
-        matrix.Zero();
+        float distance = point.m_x * normalX + point.m_y * normalY + point.m_z * normalZ - intercept;
 
-        float tanFov = tanf(0.5f * fov); // fov is in radians!
+        if(distance >= 0.0f)
+            return PointInFrontOfPlane;
 
-        matrix[0] = 1.f / (scrRatio * tanFov);
-        matrix[5] = 1.f / tanFov;
-        matrix[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
-        matrix[11] = -1.f;
-        matrix[14] = -2.f * farPlane * nearPlane / (farPlane - nearPlane);
+        return PointBehindPlane; 
     }
 
-
-    // create orthographic projection matrix
-    void MakeOrthogonal(Math::Matrix4f &matrix, float left, float right, float bottom, float top, float nearPlane, float farPlane)
+    // create perspective projection matrix
+    void MakePerspective(Math::Matrix4f &matrix, float fov, float scrRatio, float nearPlane, float farPlane)
     {
-        matrix.Identity();
-
-        matrix[0] = 2.f / (right - left);
-        matrix[5] = 2.f / (top - bottom);
-        matrix[10] = -2.f / (farPlane - nearPlane);
-        matrix[12] = -(right + left) / (right - left);
-        matrix[13] = -(top + bottom) / (top - bottom);
-        matrix[14] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        MakePerspectiveTan(matrix, tanf(0.5f * fov), scrRatio, nearPlane, farPlane); // fov is in radians!
     }
 
     // create view matrix
@@ -345,4 +672,189 @@ namespace Math
         matrix[13] = -y.DotProduct(eye);
         matrix[14] = z.DotProduct(eye);
     }
+
+/*
+ * Scalar reference implementations
+ */
+    namespace Scalar
+    {
+        Matrix4f Multiply(const Matrix4f &m1, const Matrix4f &m2)
+        {
+            return Matrix4f(m1[0] * m2[0] + m1[1] * m2[4] + m1[2] * m2[8]  + m1[3] * m2[12],
+                            m1[0] * m2[1] + m1[1] * m2[5] + m1[2] * m2[9]  + m1[3] * m2[13],
+                            m1[0] * m2[2] + m1[1] * m2[6] + m1[2] * m2[10] + m1[3] * m2[14],
+                            m1[0] * m2[3] + m1[1] * m2[7] + m1[2] * m2[11] + m1[3] * m2[15],
+
+                            m1[4] * m2[0] + m1[5] * m2[4] + m1[6] * m2[8]  + m1[7] * m2[12],
+                            m1[4] * m2[1] + m1[5] * m2[5] + m1[6] * m2[9]  + m1[7] * m2[13],
+                            m1[4] * m2[2] + m1[5] * m2[6] + m1[6] * m2[10] + m1[7] * m2[14],
+                            m1[4] * m2[3] + m1[5] * m2[7] + m1[6] * m2[11] + m1[7] * m2[15],
+
+                            m1[8] * m2[0] + m1[9] * m2[4] + m1[10] * m2[8]  + m1[11] * m2[12],
+                            m1[8] * m2[1] + m1[9] * m2[5] + m1[10] * m2[9]  + m1[11] * m2[13],
+                            m1[8] * m2[2] + m1[9] * m2[6] + m1[10] * m2[10] + m1[11] * m2[14],
+                            m1[8] * m2[3] + m1[9] * m2[7] + m1[10] * m2[11] + m1[11] * m2[15],
+
+                            m1[12] * m2[0] + m1[13] * m2[4] + m1[14] * m2[8]  + m1[15] * m2[12],
+                            m1[12] * m2[1] + m1[13] * m2[5] + m1[14] * m2[9]  + m1[15] * m2[13],
+                            m1[12] * m2[2] + m1[13] * m2[6] + m1[14] * m2[10] + m1[15] * m2[14],
+                            m1[12] * m2[3] + m1[13] * m2[7] + m1[14] * m2[11] + m1[15] * m2[15]
+                            );
+        }
+
+        void Transpose(Matrix4f &matrix)
+        {
+            Matrix4f temp;
+
+            for (int i = 0; i < 16; i++)
+                temp[i] = matrix[i];
+
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    matrix[i * 4 + j] = temp[i + j * 4];
+                }
+            }
+        }
+
+        Vector4f Transform(const Matrix4f &m, const Vector4f &v)
+        {
+            return Vector4f(v.m_x * m[0] + v.m_y * m[4] + v.m_z * m[8]  + v.m_w * m[12],
+                            v.m_x * m[1] + v.m_y * m[5] + v.m_z * m[9]  + v.m_w * m[13],
+                            v.m_x * m[2] + v.m_y * m[6] + v.m_z * m[10] + v.m_w * m[14],
+                            v.m_x * m[3] + v.m_y * m[7] + v.m_z * m[11] + v.m_w * m[15]);
+        }
+
+        void TransformPoints(const Matrix4f &matrix, const Vector3f *in, Vector4f *out, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = Transform(matrix, Vector4f(in[i].m_x, in[i].m_y, in[i].m_z, 1.f));
+        }
+
+        // cofactor expansion using 2x2 sub-determinants of the top and bottom two rows
+        bool Invert(Matrix4f &m)
+        {
+            float s0 = m[0] * m[5] - m[1] * m[4];
+            float s1 = m[0] * m[6] - m[2] * m[4];
+            float s2 = m[0] * m[7] - m[3] * m[4];
+            float s3 = m[1] * m[6] - m[2] * m[5];
+            float s4 = m[1] * m[7] - m[3] * m[5];
+            float s5 = m[2] * m[7] - m[3] * m[6];
+
+            float c5 = m[10] * m[15] - m[11] * m[14];
+            float c4 = m[9]  * m[15] - m[11] * m[13];
+            float c3 = m[9]  * m[14] - m[10] * m[13];
+            float c2 = m[8]  * m[15] - m[11] * m[12];
+            float c1 = m[8]  * m[14] - m[10] * m[12];
+            float c0 = m[8]  * m[13] - m[9]  * m[12];
+
+            float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+            if (det == 0.f)
+                return false;
+
+            float invDet = 1.f / det;
+
+            m = Matrix4f(( m[5]  * c5 - m[6]  * c4 + m[7]  * c3) * invDet,
+                         (-m[1]  * c5 + m[2]  * c4 - m[3]  * c3) * invDet,
+                         ( m[13] * s5 - m[14] * s4 + m[15] * s3) * invDet,
+                         (-m[9]  * s5 + m[10] * s4 - m[11] * s3) * invDet,
+
+                         (-m[4]  * c5 + m[6]  * c2 - m[7]  * c1) * invDet,
+                         ( m[0]  * c5 - m[2]  * c2 + m[3]  * c1) * invDet,
+                         (-m[12] * s5 + m[14] * s2 - m[15] * s1) * invDet,
+                         ( m[8]  * s5 - m[10] * s2 + m[11] * s1) * invDet,
+
+                         ( m[4]  * c4 - m[5]  * c2 + m[7]  * c0) * invDet,
+                         (-m[0]  * c4 + m[1]  * c2 - m[3]  * c0) * invDet,
+                         ( m[12] * s4 - m[13] * s2 + m[15] * s0) * invDet,
+                         (-m[8]  * s4 + m[9]  * s2 - m[11] * s0) * invDet,
+
+                         (-m[4]  * c3 + m[5]  * c1 - m[6]  * c0) * invDet,
+                         ( m[0]  * c3 - m[1]  * c1 + m[2]  * c0) * invDet,
+                         (-m[12] * s3 + m[13] * s1 - m[14] * s0) * invDet,
+                         ( m[8]  * s3 - m[9]  * s1 + m[10] * s0) * invDet);
+            return true;
+        }
+
+        // rows of the inverse 3x3 are the columns of the cofactor rows divided by the determinant
+        bool InvertAffine(Matrix4f &m)
+        {
+            Vector3f r0(m[0], m[1], m[2]);
+            Vector3f r1(m[4], m[5], m[6]);
+            Vector3f r2(m[8], m[9], m[10]);
+
+            Vector3f c0 = r1.CrossProduct(r2);
+            Vector3f c1 = r2.CrossProduct(r0);
+            Vector3f c2 = r0.CrossProduct(r1);
+
+            float det = r0.DotProduct(c0);
+            if (det == 0.f)
+                return false;
+
+            float invDet = 1.f / det;
+            Vector3f i0 = Vector3f(c0.m_x, c1.m_x, c2.m_x) * invDet;
+            Vector3f i1 = Vector3f(c0.m_y, c1.m_y, c2.m_y) * invDet;
+            Vector3f i2 = Vector3f(c0.m_z, c1.m_z, c2.m_z) * invDet;
+            Vector3f t(m[12], m[13], m[14]);
+
+            m = Matrix4f(i0.m_x, i0.m_y, i0.m_z, 0.f,
+                         i1.m_x, i1.m_y, i1.m_z, 0.f,
+                         i2.m_x, i2.m_y, i2.m_z, 0.f,
+                         -(t.m_x * i0.m_x + t.m_y * i1.m_x + t.m_z * i2.m_x),
+                         -(t.m_x * i0.m_y + t.m_y * i1.m_y + t.m_z * i2.m_y),
+                         -(t.m_x * i0.m_z + t.m_y * i1.m_z + t.m_z * i2.m_z),
+                         1.f);
+            return true;
+        }
+
+        void InvertOrthonormal(Matrix4f &m)
+        {
+            float tx = m[12];
+            float ty = m[13];
+            float tz = m[14];
+
+            m = Matrix4f(m[0], m[4], m[8],  0.f,
+                         m[1], m[5], m[9],  0.f,
+                         m[2], m[6], m[10], 0.f,
+                         -(tx * m[0] + ty * m[1] + tz * m[2]),
+                         -(tx * m[4] + ty * m[5] + tz * m[6]),
+                         -(tx * m[8] + ty * m[9] + tz * m[10]),
+                         1.f);
+        }
+
+        bool MakeNormalMatrix(Matrix4f &normalMatrix, const Matrix4f &model)
+        {
+            Vector3f r0(model[0], model[1], model[2]);
+            Vector3f r1(model[4], model[5], model[6]);
+            Vector3f r2(model[8], model[9], model[10]);
+
+            Vector3f c0 = r1.CrossProduct(r2);
+            Vector3f c1 = r2.CrossProduct(r0);
+            Vector3f c2 = r0.CrossProduct(r1);
+
+            float det = r0.DotProduct(c0);
+            if (det == 0.f)
+            {
+                normalMatrix.Identity();
+                return false;
+            }
+
+            c0 = c0 / det;
+            c1 = c1 / det;
+            c2 = c2 / det;
+
+            normalMatrix = Matrix4f(c0.m_x, c0.m_y, c0.m_z, 0.f,
+                                    c1.m_x, c1.m_y, c1.m_z, 0.f,
+                                    c2.m_x, c2.m_y, c2.m_z, 0.f,
+                                    0.f,    0.f,    0.f,    1.f);
+            return true;
+        }
+
+        Vector3f Rotate(const Quaternion &q, const Vector3f &v)
+        {
+            Quaternion result = q * Quaternion(v.m_x, v.m_y, v.m_z, 0.f) * q.GetConjugate();
+            return Vector3f(result.m_x, result.m_y, result.m_z);
+        }
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MATH_INCLUDED
 
 #include <math.h>
+#include <stddef.h>
 
 /*
  * Basic math structures (vectors, quaternions, matrices)
@@ -14,11 +15,19 @@
 
 namespace Math
 {
+    // precision of the reciprocal square root used by the Quick* and batched normalization functions
+    enum RsqrtAccuracy
+    {
+        RsqrtEstimate, // hardware estimate only (rsqrtps, ~12 bits)
+        RsqrtRefined,  // estimate + one Newton-Raphson step (~22 bits)
+        RsqrtExact     // 1 / sqrtf()
+    };
+
     // 2D vector
     struct Vector2f
     {
-        Vector2f() {}
-        Vector2f(float x, float y) : m_x(x), m_y(y) {}
+        constexpr Vector2f() {}
+        constexpr Vector2f(float x, float y) : m_x(x), m_y(y) {}
 
         float m_x = 0.f;
         float m_y = 0.f;
@@ -28,9 +37,9 @@ namespace Math
     class Vector3f
     {
     public:
-        Vector3f() {}
-        Vector3f(float x, float y, float z) : m_x(x), m_y(y), m_z(z) {}
-        Vector3f(const Vector3f &v2) : m_x(v2.m_x), m_y(v2.m_y), m_z(v2.m_z) {}
+        constexpr Vector3f() {}
+        constexpr Vector3f(float x, float y, float z) : m_x(x), m_y(y), m_z(z) {}
+        constexpr Vector3f(const Vector3f &v2) = default;
 
         float Length()
         {
@@ -38,25 +47,34 @@ namespace Math
         }
 
         void Normalize();
-        void QuickNormalize(); // normalize with Q_rsqrt
-        Vector3f CrossProduct(const Vector3f &v2) const;
-        float DotProduct(const Vector3f &v2) const;
+        void QuickNormalize(RsqrtAccuracy accuracy = RsqrtRefined); // normalize with approximate rsqrt (zero length is left as is)
+        constexpr Vector3f CrossProduct(const Vector3f &v2) const
+        {
+            return Vector3f( m_y*v2.m_z - m_z*v2.m_y,
+                             m_z*v2.m_x - m_x*v2.m_z,
+                             m_x*v2.m_y - m_y*v2.m_x );
+        }
+
+        constexpr float DotProduct(const Vector3f &v2) const
+        {
+            return m_x*v2.m_x + m_y*v2.m_y + m_z*v2.m_z;
+        }
 
         float m_x = 0.f;
         float m_y = 0.f;
         float m_z = 0.f;
 
-        Vector3f operator+ (const Vector3f &v2) const;
-        Vector3f operator- (const Vector3f &v2) const;
-        Vector3f operator* (float r) const;           // scale the vector by r
-        Vector3f operator/ (float r) const;           // added for completeness with *
+        constexpr Vector3f operator+ (const Vector3f &v2) const { return Vector3f(m_x + v2.m_x, m_y + v2.m_y, m_z + v2.m_z); }
+        constexpr Vector3f operator- (const Vector3f &v2) const { return Vector3f(m_x - v2.m_x, m_y - v2.m_y, m_z - v2.m_z); }
+        constexpr Vector3f operator* (float r) const { return Vector3f(m_x * r, m_y * r, m_z * r); } // scale the vector by r
+        constexpr Vector3f operator/ (float r) const { return Vector3f(m_x / r, m_y / r, m_z / r); } // added for completeness with *
     };
 
     // 4D vector
     struct Vector4f
     {
-        Vector4f() {}
-        Vector4f(float x, float y, float z, float w) : m_x(x), m_y(y), m_z(z), m_w(w) {}
+        constexpr Vector4f() {}
+        constexpr Vector4f(float x, float y, float z, float w) : m_x(x), m_y(y), m_z(z), m_w(w) {}
 
         float m_x = 0.f;
         float m_y = 0.f;
@@ -64,70 +82,57 @@ namespace Math
         float m_w = 0.f;
     };
 
-    struct Matrix4f
+    // 16-byte aligned so that rows can be loaded directly into SIMD registers
+    struct alignas(16) Matrix4f
     {
-        Matrix4f()
+        constexpr Matrix4f() : m_m{ 1.f, 0.f, 0.f, 0.f,
+                                    0.f, 1.f, 0.f, 0.f,
+                                    0.f, 0.f, 1.f, 0.f,
+                                    0.f, 0.f, 0.f, 1.f } {}
+
+        constexpr Matrix4f(float m0,  float m1,  float m2,  float m3,
+                           float m4,  float m5,  float m6,  float m7,
+                           float m8,  float m9,  float m10, float m11,
+                           float m12, float m13, float m14, float m15) : m_m{ m0,  m1,  m2,  m3,
+                                                                              m4,  m5,  m6,  m7,
+                                                                              m8,  m9,  m10, m11,
+                                                                              m12, m13, m14, m15 } {}
+
+        // construct matrix from raw array of floats
+        constexpr Matrix4f(const float *mData) : m_m{ mData[0],  mData[1],  mData[2],  mData[3],
+                                                      mData[4],  mData[5],  mData[6],  mData[7],
+                                                      mData[8],  mData[9],  mData[10], mData[11],
+                                                      mData[12], mData[13], mData[14], mData[15] } {}
+
+        constexpr void Identity()
         {
-            Identity();
+            *this = Matrix4f();
         }
 
-        Matrix4f(float m0,  float m1,  float m2,  float m3,
-                 float m4,  float m5,  float m6,  float m7,
-                 float m8,  float m9,  float m10, float m11,
-                 float m12, float m13, float m14, float m15)
+        constexpr void Zero()
         {
-            m_m[0]  = m0;
-            m_m[1]  = m1;
-            m_m[2]  = m2;
-            m_m[3]  = m3;
-            m_m[4]  = m4;
-            m_m[5]  = m5;
-            m_m[6]  = m6;
-            m_m[7]  = m7;
-            m_m[8]  = m8;
-            m_m[9]  = m9;
-            m_m[10] = m10;
-            m_m[11] = m11;
-            m_m[12] = m12;
-            m_m[13] = m13;
-            m_m[14] = m14;
-            m_m[15] = m15;
+            for (int i = 0; i < 16; i++)
+                m_m[i] = 0.f;
         }
 
-        // construct matrix from raw array of floats
-        Matrix4f(float *mData)
+        constexpr void One()
         {
-            m_m[0]  = mData[0];
-            m_m[1]  = mData[1];
-            m_m[2]  = mData[2];
-            m_m[3]  = mData[3];
-            m_m[4]  = mData[4];
-            m_m[5]  = mData[5];
-            m_m[6]  = mData[6];
-            m_m[7]  = mData[7];
-            m_m[8]  = mData[8];
-            m_m[9]  = mData[9];
-            m_m[10] = mData[10];
-            m_m[11] = mData[11];
-            m_m[12] = mData[12];
-            m_m[13] = mData[13];
-            m_m[14] = mData[14];
-            m_m[15] = mData[15];
+            for (int i = 0; i < 16; i++)
+                m_m[i] = 1.f;
         }
 
-        void Identity();
-        void Zero();
-        void One();
         void Transpose();
-        void Invert();
+        bool Invert();            // general inverse - returns false and leaves the matrix untouched if singular
+        bool InvertAffine();      // rotation/scale + translation only (m[3], m[7], m[11] = 0, m[15] = 1)
+        void InvertOrthonormal(); // rotation + translation only, no scale
 
         float m_m[16];
 
-        Vector3f operator* (const Vector3f &v) const;
-        Vector4f operator* (const Vector4f &v) const;
+        Vector3f operator* (const Vector3f &v) const; // point: xyz of matrix * Vector4f(v, 1)
+        Vector4f operator* (const Vector4f &v) const; // column vector, as in shaders: x * m[0..3] + y * m[4..7] + z * m[8..11] + w * m[12..15]
         Matrix4f operator* (const Matrix4f &m) const;
-        float& operator[](unsigned int i){ return m_m[i]; }
-        const float& operator[](unsigned int i)const{ return m_m[i]; }
+        constexpr float& operator[](unsigned int i){ return m_m[i]; }
+        constexpr const float& operator[](unsigned int i)const{ return m_m[i]; }
     };
 
 
@@ -135,27 +140,44 @@ namespace Math
     class Quaternion
     {
     public:
-        Quaternion() {}
+        constexpr Quaternion() {}
         // create based on standard parameters
-        Quaternion(float x, float y, float z, float w) : m_x(x), m_y(y), m_z(z), m_w(w) {}
+        constexpr Quaternion(float x, float y, float z, float w) : m_x(x), m_y(y), m_z(z), m_w(w) {}
         // create from axis/angle representaiton
         Quaternion(const Vector3f &axis, float angle) : m_x( axis.m_x * sinf(angle/2) ),
                                                         m_y( axis.m_y * sinf(angle/2) ),
                                                         m_z( axis.m_z * sinf(angle/2) ),
                                                         m_w( cosf(angle/2) ) {}
-        Quaternion(const Quaternion &q2) : m_x(q2.m_x), m_y(q2.m_y), m_z(q2.m_z), m_w(q2.m_w) {}
+        constexpr Quaternion(const Quaternion &q2) = default;
 
-        Quaternion GetConjugate() const;
+        constexpr Quaternion GetConjugate() const { return Quaternion(-m_x, -m_y, -m_z, m_w); }
         void Normalize();
-        void QuickNormalize(); // normalize with Q_rsqrt
+        void QuickNormalize(RsqrtAccuracy accuracy = RsqrtRefined); // normalize with approximate rsqrt (zero length is left as is)
 
         float m_x = 0.f;
         float m_y = 0.f;
         float m_z = 0.f;
         float m_w = 0.f;
 
-        Vector3f   operator*(const Vector3f &vec)  const;   // apply quat-rotation to vec
-        Quaternion operator*(const Quaternion &q2) const;
+        Matrix4f ToMatrix() const; // rotation matrix (unit quaternion only), laid out for the GPU like MakeView
+
+        // apply quat-rotation to vec - quaternion must be unit length, vec keeps its length
+        constexpr Vector3f operator*(const Vector3f &vec) const
+        {
+            // v' = v + w * t + u x t, where u = (x, y, z) and t = 2 * (u x v)
+            Vector3f u(m_x, m_y, m_z);
+            Vector3f t = u.CrossProduct(vec) * 2.f;
+
+            return vec + t * m_w + u.CrossProduct(t);
+        }
+
+        constexpr Quaternion operator*(const Quaternion &q2) const
+        {
+            return Quaternion( m_w*q2.m_x + m_x*q2.m_w + m_y*q2.m_z - m_z*q2.m_y,
+                               m_w*q2.m_y - m_x*q2.m_z + m_y*q2.m_w + m_z*q2.m_x,
+                               m_w*q2.m_z + m_x*q2.m_y - m_y*q2.m_x + m_z*q2.m_w,
+                               m_w*q2.m_w - m_x*q2.m_x - m_y*q2.m_y - m_z*q2.m_z );
+        }
     };
 
 
@@ -168,20 +190,125 @@ namespace Math
         PointInFrontOfPlane
     };
 
-    // quick inverse square root
-    float QuickInverseSqrt( float number );
+    // interpolate between unit quaternions along the shorter arc
+    Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t);
+    Quaternion Nlerp(const Quaternion &q1, const Quaternion &q2, float t); // cheaper, but angular velocity is not constant
+
+    // rotate n vectors by one quaternion, or by a quaternion per vector (in-place allowed)
+    void RotateVectors(const Quaternion &q, const Vector3f *in, Vector3f *out, size_t n);
+    void RotateVectors(const Quaternion *q, const Vector3f *in, Vector3f *out, size_t n);
+
+    // quick inverse square root (number > 0)
+    float QuickInverseSqrt( float number, RsqrtAccuracy accuracy = RsqrtRefined );
+    // out[i] = 1 / sqrt(in[i]) for n positive values (in-place allowed)
+    void InverseSqrt(const float *in, float *out, size_t n, RsqrtAccuracy accuracy = RsqrtRefined);
+    // normalize n vectors/quaternions in place - zero-length ones are left as they are
+    void NormalizeVectors(Vector3f *v, size_t n, RsqrtAccuracy accuracy = RsqrtRefined);
+    void NormalizeQuaternions(Quaternion *q, size_t n, RsqrtAccuracy accuracy = RsqrtRefined);
+
+    // transform n points (w = 1, so translation applies) by matrix - same result as matrix * Vector4f(in[i], 1) for each element
+    void TransformPoints(const Matrix4f &matrix, const Vector3f *in, Vector4f *out, size_t n);
+    // out[i] = a[i] * b for n matrices (in-place allowed)
+    void MultiplyMatrices(const Matrix4f *a, const Matrix4f &b, Matrix4f *out, size_t n);
+
+    // inverse-transpose of the upper 3x3 for transforming normals (no translation) - identity and false if singular
+    bool MakeNormalMatrix(Matrix4f &normalMatrix, const Matrix4f &model);
+
+    // batched versions of the above - return the number of singular inputs (inverses of those are copied through as-is)
+    size_t InvertMatrices(const Matrix4f *in, Matrix4f *out, size_t n);
+    size_t InvertAffineMatrices(const Matrix4f *in, Matrix4f *out, size_t n);
+    size_t MakeNormalMatrices(const Matrix4f *model, Matrix4f *out, size_t n);
 
     // determine whether a point is in front of or behind a plane (based on its normal vector)
     int PointPlanePos(float normalX, float normalY, float normalZ, float intercept, const Math::Vector3f &point);
 
     // translate matrix by (x,y,z)
-    void Translate(Matrix4f &matrix, float x, float y=0.0f, float z=0.0f);
+    constexpr void Translate(Matrix4f &matrix, float x, float y=0.0f, float z=0.0f)
+    {
+        float tx = x;
+        float ty = y;
+        float tz = z;
+        float tw = 1.f;
+
+        float t1 = matrix[0] * tx + matrix[4] * ty + matrix[8]  * tz + matrix[12] * tw;
+        float t2 = matrix[1] * tx + matrix[5] * ty + matrix[9]  * tz + matrix[13] * tw;
+        float t3 = matrix[2] * tx + matrix[6] * ty + matrix[10] * tz + matrix[14] * tw;
+        float t4 = matrix[3] * tx + matrix[7] * ty + matrix[11] * tz + matrix[15] * tw;
+
+        matrix[12] = t1;
+        matrix[13] = t2;
+        matrix[14] = t3;
+        matrix[15] = t4;
+    }
+
     // scale matrix by (x,y,z)
-    void Scale(Matrix4f &matrix, float x, float y=1.0f, float z=1.0f);
+    constexpr void Scale(Matrix4f &matrix, float x, float y=1.0f, float z=1.0f)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            matrix[i]     *= x;
+            matrix[4 + i] *= y;
+            matrix[8 + i] *= z;
+        }
+    }
 
     // rendering matrices
     void MakePerspective(Math::Matrix4f &matrix, float fov, float scrRatio, float nearPlane, float farPlane);
-    void MakeOrthogonal(Math::Matrix4f &matrix, float left, float right, float bottom, float top, float nearPlane, float farPlane);
+
+    // same as MakePerspective, with the field of view passed in as tan(fov / 2) so it can be evaluated at compile time
+    constexpr void MakePerspectiveTan(Math::Matrix4f &matrix, float tanHalfFov, float scrRatio, float nearPlane, float farPlane)
+    {
+        matrix.Zero();
+
+        matrix[0] = 1.f / (scrRatio * tanHalfFov);
+        matrix[5] = 1.f / tanHalfFov;
+        matrix[10] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        matrix[11] = -1.f;
+        matrix[14] = -2.f * farPlane * nearPlane / (farPlane - nearPlane);
+    }
+
+    constexpr void MakeOrthogonal(Math::Matrix4f &matrix, float left, float right, float bottom, float top, float nearPlane, float farPlane)
+    {
+        matrix.Identity();
+
+        matrix[0] = 2.f / (right - left);
+        matrix[5] = 2.f / (top - bottom);
+        matrix[10] = -2.f / (farPlane - nearPlane);
+        matrix[12] = -(right + left) / (right - left);
+        matrix[13] = -(top + bottom) / (top - bottom);
+        matrix[14] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+    }
+
+    // converts projection matrices to Vulkan clip space: y pointing down, 0..1 depth (https://matthewwellings.com/blog/the-new-vulkan-coordinate-system/)
+    inline constexpr Matrix4f VulkanClipCorrection(1.f,  0.f, 0.f,  0.f,
+                                                   0.f, -1.f, 0.f,  0.f,
+                                                   0.f,  0.f, 0.5f, 0.f,
+                                                   0.f,  0.f, 0.5f, 1.f);
+
+    // projection = projection * VulkanClipCorrection, touching only the two affected columns
+    constexpr void ApplyVulkanClipCorrection(Math::Matrix4f &projection)
+    {
+        for (int i = 0; i < 16; i += 4)
+        {
+            projection[i + 1] = -projection[i + 1];
+            projection[i + 2] = 0.5f * (projection[i + 2] + projection[i + 3]);
+        }
+    }
+
     void MakeView(Math::Matrix4f &matrix, const Math::Vector3f &eye, const Math::Vector3f &target, const Math::Vector3f &up);
+
+    // plain C++ versions of the SIMD kernels - always available as reference for correctness checks
+    namespace Scalar
+    {
+        Matrix4f Multiply(const Matrix4f &m1, const Matrix4f &m2);
+        void     Transpose(Matrix4f &matrix);
+        Vector4f Transform(const Matrix4f &matrix, const Vector4f &v);
+        void     TransformPoints(const Matrix4f &matrix, const Vector3f *in, Vector4f *out, size_t n);
+        bool     Invert(Matrix4f &matrix);
+        bool     InvertAffine(Matrix4f &matrix);
+        void     InvertOrthonormal(Matrix4f &matrix);
+        bool     MakeNormalMatrix(Matrix4f &normalMatrix, const Matrix4f &model);
+        Vector3f Rotate(const Quaternion &q, const Vector3f &v); // q * v * q^-1 as full quaternion products
+    }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "MathFrustum.hpp"
+#include "MathSIMD.hpp"
+#include <stddef.h>
+#include <string.h>
+
+namespace Math
+{
+    static_assert(sizeof(Sphere) == 4 * sizeof(float) && offsetof(Sphere, m_radius) == 3 * sizeof(float), "Sphere must be packed as (x, y, z, radius)");
+
+    static void setPlane(Plane &plane, float a, float b, float c, float d)
+    {
+        float length = sqrtf(a * a + b * b + c * c);
+        float invLength = length > 0.f ? 1.f / length : 0.f;
+
+        plane.m_normal = Vector3f(a * invLength, b * invLength, c * invLength);
+        plane.m_intercept = -d * invLength;
+    }
+
+    // distance to the plane of the box vertex furthest along the plane normal, measured from the box center
+    static inline float projectedExtent(const Vector3f &normal, const Vector3f &extents)
+    {
+        return fabsf(normal.m_x) * extents.m_x + fabsf(normal.m_y) * extents.m_y + fabsf(normal.m_z) * extents.m_z;
+    }
+
+/*
+ * Frustum
+ */
+    void Frustum::Extract(const Matrix4f &m)
+    {
+        // Gribb-Hartmann: matrices are laid out for column vectors (see MakeView), so clip space row r is (m[r], m[4+r], m[8+r], m[12+r])
+        setPlane(m_planes[PLANE_LEFT],   m[3] + m[0], m[7] + m[4], m[11] + m[8],  m[15] + m[12]);
+        setPlane(m_planes[PLANE_RIGHT],  m[3] - m[0], m[7] - m[4], m[11] - m[8],  m[15] - m[12]);
+        setPlane(m_planes[PLANE_BOTTOM], m[3] + m[1], m[7] + m[5], m[11] + m[9],  m[15] + m[13]);
+        setPlane(m_planes[PLANE_TOP],    m[3] - m[1], m[7] - m[5], m[11] - m[9],  m[15] - m[13]);
+        // Vulkan depth range is 0..w, so the near plane is the z row alone
+        setPlane(m_planes[PLANE_NEAR],   m[2],        m[6],        m[10],         m[14]);
+        setPlane(m_planes[PLANE_FAR],    m[3] - m[2], m[7] - m[6], m[11] - m[10], m[15] - m[14]);
+    }
+
+    bool Frustum::ContainsPoint(const Vector3f &point) const
+    {
+        for (int i = 0; i < PLANE_COUNT; ++i)
+        {
+            const Plane &p = m_planes[i];
+            if (PointPlanePos(p.m_normal.m_x, p.m_normal.m_y, p.m_normal.m_z, p.m_intercept, point) == PointBehindPlane)
+                return false;
+        }
+
+        return true;
+    }
+
+    // volumes are tested by moving each plane outwards by the volume's extent along the plane normal
+    bool Frustum::IntersectsSphere(const Vector3f &center, float radius) const
+    {
+        for (int i = 0; i < PLANE_COUNT; ++i)
+        {
+            const Plane &p = m_planes[i];
+            if (PointPlanePos(p.m_normal.m_x, p.m_normal.m_y, p.m_normal.m_z, p.m_intercept - radius, center) == PointBehindPlane)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Frustum::IntersectsAABB(const Vector3f &min, const Vector3f &max) const
+    {
+        Vector3f center  = (min + max) * 0.5f;
+        Vector3f extents = (max - min) * 0.5f;
+
+        for (int i = 0; i < PLANE_COUNT; ++i)
+        {
+            const Plane &p = m_planes[i];
+            float r = projectedExtent(p.m_normal, extents);
+
+            if (PointPlanePos(p.m_normal.m_x, p.m_normal.m_y, p.m_normal.m_z, p.m_intercept - r, center) == PointBehindPlane)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Frustum::IntersectsOBB(const OBB &box) const
+    {
+        for (int i = 0; i < PLANE_COUNT; ++i)
+        {
+            const Plane &p = m_planes[i];
+            Vector3f axisProjection(fabsf(p.m_normal.DotProduct(box.m_axes[0])),
+                                    fabsf(p.m_normal.DotProduct(box.m_axes[1])),
+                                    fabsf(p.m_normal.DotProduct(box.m_axes[2])));
+            float r = axisProjection.DotProduct(box.m_extents);
+
+            if (PointPlanePos(p.m_normal.m_x, p.m_normal.m_y, p.m_normal.m_z, p.m_intercept - r, box.m_center) == PointBehindPlane)
+                return false;
+        }
+
+        return true;
+    }
+
+/*
+ * Batched culling - 4 volumes per iteration with SSE, remaining ones go through the Frustum methods
+ */
+    static inline void clearVisibility(uint32_t *visible, size_t n)
+    {
+        memset(visible, 0, ((n + 31) / 32) * sizeof(uint32_t));
+    }
+
+    static inline void setVisible(uint32_t *visible, size_t i)
+    {
+        visible[i / 32] |= 1u << (i % 32);
+    }
+
+#ifdef MATH_SIMD_SSE
+    // frustum plane broadcast to all lanes, plus absolute values of the normal for box extents
+    struct PlaneLanes
+    {
+        __m128 nx, ny, nz, intercept;
+        __m128 absX, absY, absZ;
+    };
+
+    static void broadcastPlanes(const Frustum &frustum, PlaneLanes *planes)
+    {
+        for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+        {
+            const Plane &p = frustum.GetPlane(Frustum::FrustumPlane(i));
+            planes[i].nx = _mm_set1_ps(p.m_normal.m_x);
+            planes[i].ny = _mm_set1_ps(p.m_normal.m_y);
+            planes[i].nz = _mm_set1_ps(p.m_normal.m_z);
+            planes[i].intercept = _mm_set1_ps(p.m_intercept);
+            planes[i].absX = _mm_set1_ps(fabsf(p.m_normal.m_x));
+            planes[i].absY = _mm_set1_ps(fabsf(p.m_normal.m_y));
+            planes[i].absZ = _mm_set1_ps(fabsf(p.m_normal.m_z));
+        }
+    }
+
+    static inline __m128 planeDistance(const PlaneLanes &p, __m128 x, __m128 y, __m128 z)
+    {
+        return _mm_sub_ps(Simd::MulAdd(z, p.nz, Simd::MulAdd(y, p.ny, _mm_mul_ps(x, p.nx))), p.intercept);
+    }
+
+    static inline __m128 absLanes(__m128 a)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+    }
+
+    // write 4 visibility bits starting at i (a multiple of 4, so bits never straddle two words)
+    static inline size_t storeVisibility(uint32_t *visible, size_t i, __m128 inside)
+    {
+        static const size_t s_bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+        int bits = _mm_movemask_ps(inside);
+
+        visible[i / 32] |= uint32_t(bits) << (i % 32);
+        return s_bitCount[bits];
+    }
+#endif
+
+    size_t CullSpheres(const Frustum &frustum, const Sphere *bounds, size_t n, uint32_t *visible)
+    {
+        size_t i = 0;
+        size_t numVisible = 0;
+        clearVisibility(visible, n);
+#ifdef MATH_SIMD_SSE
+        PlaneLanes planes[Frustum::PLANE_COUNT];
+        broadcastPlanes(frustum, planes);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&bounds[i].m_center.m_x);
+            __m128 y = _mm_loadu_ps(&bounds[i + 1].m_center.m_x);
+            __m128 z = _mm_loadu_ps(&bounds[i + 2].m_center.m_x);
+            __m128 r = _mm_loadu_ps(&bounds[i + 3].m_center.m_x);
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(planeDistance(planes[p], x, y, z), r), _mm_setzero_ps()));
+
+            numVisible += storeVisibility(visible, i, inside);
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            if (frustum.IntersectsSphere(bounds[i].m_center, bounds[i].m_radius))
+            {
+                setVisible(visible, i);
+                numVisible++;
+            }
+        }
+
+        return numVisible;
+    }
+
+    size_t CullAABBs(const Frustum &frustum, const AABB *bounds, size_t n, uint32_t *visible)
+    {
+        size_t i = 0;
+        size_t numVisible = 0;
+        clearVisibility(visible, n);
+#ifdef MATH_SIMD_SSE
+        PlaneLanes planes[Frustum::PLANE_COUNT];
+        broadcastPlanes(frustum, planes);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const AABB *b = &bounds[i];
+            __m128 minX = _mm_setr_ps(b[0].m_min.m_x, b[1].m_min.m_x, b[2].m_min.m_x, b[3].m_min.m_x);
+            __m128 minY = _mm_setr_ps(b[0].m_min.m_y, b[1].m_min.m_y, b[2].m_min.m_y, b[3].m_min.m_y);
+            __m128 minZ = _mm_setr_ps(b[0].m_min.m_z, b[1].m_min.m_z, b[2].m_min.m_z, b[3].m_min.m_z);
+            __m128 maxX = _mm_setr_ps(b[0].m_max.m_x, b[1].m_max.m_x, b[2].m_max.m_x, b[3].m_max.m_x);
+            __m128 maxY = _mm_setr_ps(b[0].m_max.m_y, b[1].m_max.m_y, b[2].m_max.m_y, b[3].m_max.m_y);
+            __m128 maxZ = _mm_setr_ps(b[0].m_max.m_z, b[1].m_max.m_z, b[2].m_max.m_z, b[3].m_max.m_z);
+
+            __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+            __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+            __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+            __m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+            __m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+            __m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+            {
+                const PlaneLanes &pl = planes[p];
+                __m128 r = Simd::MulAdd(ez, pl.absZ, Simd::MulAdd(ey, pl.absY, _mm_mul_ps(ex, pl.absX)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(planeDistance(pl, cx, cy, cz), r), _mm_setzero_ps()));
+            }
+
+            numVisible += storeVisibility(visible, i, inside);
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            if (frustum.IntersectsAABB(bounds[i].m_min, bounds[i].m_max))
+            {
+                setVisible(visible, i);
+                numVisible++;
+            }
+        }
+
+        return numVisible;
+    }
+
+    size_t CullOBBs(const Frustum &frustum, const OBB *bounds, size_t n, uint32_t *visible)
+    {
+        size_t i = 0;
+        size_t numVisible = 0;
+        clearVisibility(visible, n);
+#ifdef MATH_SIMD_SSE
+        PlaneLanes planes[Frustum::PLANE_COUNT];
+        broadcastPlanes(frustum, planes);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            const OBB *b = &bounds[i];
+#define OBB_LANES(field) _mm_setr_ps(b[0].field, b[1].field, b[2].field, b[3].field)
+            __m128 cx = OBB_LANES(m_center.m_x);
+            __m128 cy = OBB_LANES(m_center.m_y);
+            __m128 cz = OBB_LANES(m_center.m_z);
+            __m128 ax[3], ay[3], az[3];
+            for (int a = 0; a < 3; ++a)
+            {
+                ax[a] = OBB_LANES(m_axes[a].m_x);
+                ay[a] = OBB_LANES(m_axes[a].m_y);
+                az[a] = OBB_LANES(m_axes[a].m_z);
+            }
+            __m128 e[3] = { OBB_LANES(m_extents.m_x), OBB_LANES(m_extents.m_y), OBB_LANES(m_extents.m_z) };
+#undef OBB_LANES
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+            {
+                const PlaneLanes &pl = planes[p];
+                __m128 r = _mm_setzero_ps();
+                for (int a = 0; a < 3; ++a)
+                {
+                    __m128 proj = Simd::MulAdd(az[a], pl.nz, Simd::MulAdd(ay[a], pl.ny, _mm_mul_ps(ax[a], pl.nx)));
+                    r = Simd::MulAdd(absLanes(proj), e[a], r);
+                }
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(planeDistance(pl, cx, cy, cz), r), _mm_setzero_ps()));
+            }
+
+            numVisible += storeVisibility(visible, i, inside);
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            if (frustum.IntersectsOBB(bounds[i]))
+            {
+                setVisible(visible, i);
+                numVisible++;
+            }
+        }
+
+        return numVisible;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef MATHFRUSTUM_INCLUDED
+#define MATHFRUSTUM_INCLUDED
+
+#include <stdint.h>
+#include "Math.hpp"
+
+/*
+ * View frustum and bounding volume tests for culling
+ */
+
+namespace Math
+{
+    // plane in the form used by PointPlanePos: points with normal.p - intercept >= 0 are in front
+    struct Plane
+    {
+        Vector3f m_normal;
+        float    m_intercept = 0.f;
+    };
+
+    struct Sphere
+    {
+        Vector3f m_center;
+        float    m_radius = 0.f;
+    };
+
+    // axis aligned box
+    struct AABB
+    {
+        Vector3f m_min;
+        Vector3f m_max;
+    };
+
+    // oriented box - axes are unit length, extents are half sizes along each axis
+    struct OBB
+    {
+        Vector3f m_center;
+        Vector3f m_axes[3] = { Vector3f(1.f, 0.f, 0.f), Vector3f(0.f, 1.f, 0.f), Vector3f(0.f, 0.f, 1.f) };
+        Vector3f m_extents;
+    };
+
+    class Frustum
+    {
+    public:
+        enum FrustumPlane
+        {
+            PLANE_LEFT,
+            PLANE_RIGHT,
+            PLANE_BOTTOM,
+            PLANE_TOP,
+            PLANE_NEAR,
+            PLANE_FAR,
+            PLANE_COUNT
+        };
+
+        Frustum() {}
+        explicit Frustum(const Matrix4f &viewProjection) { Extract(viewProjection); }
+
+        // extract normalized planes (facing inwards) from a view-projection matrix with Vulkan clip space (0..1 depth)
+        void Extract(const Matrix4f &viewProjection);
+
+        // tests are conservative - volumes near frustum corners may be reported visible
+        bool ContainsPoint(const Vector3f &point) const;
+        bool IntersectsSphere(const Vector3f &center, float radius) const;
+        bool IntersectsAABB(const Vector3f &min, const Vector3f &max) const;
+        bool IntersectsOBB(const OBB &box) const;
+
+        const Plane &GetPlane(FrustumPlane plane) const { return m_planes[plane]; }
+    private:
+        Plane m_planes[PLANE_COUNT];
+    };
+
+    // batched tests - bit (i % 32) of visible[i / 32] is set if bounds[i] is at least partially inside the frustum
+    // visible must hold (n + 31) / 32 words, the return value is the number of visible objects
+    size_t CullSpheres(const Frustum &frustum, const Sphere *bounds, size_t n, uint32_t *visible);
+    size_t CullAABBs(const Frustum &frustum, const AABB *bounds, size_t n, uint32_t *visible);
+    size_t CullOBBs(const Frustum &frustum, const OBB *bounds, size_t n, uint32_t *visible);
+}
+#endif
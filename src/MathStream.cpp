@@ -0,0 +1,349 @@
+#include "MathStream.hpp"
+#include "MathSIMD.hpp"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+
+namespace Math
+{
+    // component arrays are padded to the widest SIMD register (AVX) and aligned to it
+    static const size_t s_streamPadding   = 8;
+    static const size_t s_streamAlignment = 32;
+
+    static size_t paddedCount(size_t count)
+    {
+        return (count + s_streamPadding - 1) & ~(s_streamPadding - 1);
+    }
+
+    // allocate zeroed storage for numComponents arrays of capacity floats - returns the buffer to delete[] later
+    static float *allocComponents(size_t capacity, size_t numComponents, float *&aligned)
+    {
+        float *buffer = new float[capacity * numComponents + s_streamAlignment / sizeof(float)]();
+        uintptr_t address = (reinterpret_cast<uintptr_t>(buffer) + s_streamAlignment - 1) & ~uintptr_t(s_streamAlignment - 1);
+        aligned = reinterpret_cast<float *>(address);
+        return buffer;
+    }
+
+    // grow or shrink the component arrays, keeping the first min(size, count) elements and zeroing the rest
+    static void resizeComponents(float *&buffer, float **components, size_t numComponents, size_t &size, size_t &capacity, size_t count)
+    {
+        if (count <= capacity)
+        {
+            // elements dropped when shrinking become padding, which has to read as zero again
+            for (size_t c = 0; c < numComponents; ++c)
+            {
+                if (count > size)
+                    memset(components[c] + size, 0, (count - size) * sizeof(float));
+                else
+                    memset(components[c] + count, 0, (size - count) * sizeof(float));
+            }
+
+            size = count;
+            return;
+        }
+
+        size_t newCapacity = paddedCount(count);
+        float *base;
+        float *newBuffer = allocComponents(newCapacity, numComponents, base);
+
+        for (size_t c = 0; c < numComponents; ++c)
+        {
+            float *dst = base + c * newCapacity;
+            if (size > 0)
+                memcpy(dst, components[c], size * sizeof(float));
+            components[c] = dst;
+        }
+
+        delete[] buffer;
+        buffer   = newBuffer;
+        size     = count;
+        capacity = newCapacity;
+    }
+
+/*
+ * Vector3fStream
+ */
+    Vector3fStream::Vector3fStream(size_t count)
+    {
+        Resize(count);
+    }
+
+    Vector3fStream::Vector3fStream(const Vector3f *v, size_t count)
+    {
+        Load(v, count);
+    }
+
+    Vector3fStream::Vector3fStream(const Vector3fStream &s2)
+    {
+        *this = s2;
+    }
+
+    Vector3fStream::Vector3fStream(Vector3fStream &&s2)
+    {
+        *this = std::move(s2);
+    }
+
+    Vector3fStream::~Vector3fStream()
+    {
+        delete[] m_buffer;
+    }
+
+    Vector3fStream &Vector3fStream::operator=(const Vector3fStream &s2)
+    {
+        if (this != &s2)
+        {
+            Resize(s2.m_size);
+            if (m_size == 0)
+                return *this;
+
+            memcpy(m_x, s2.m_x, m_size * sizeof(float));
+            memcpy(m_y, s2.m_y, m_size * sizeof(float));
+            memcpy(m_z, s2.m_z, m_size * sizeof(float));
+        }
+
+        return *this;
+    }
+
+    Vector3fStream &Vector3fStream::operator=(Vector3fStream &&s2)
+    {
+        std::swap(m_size, s2.m_size);
+        std::swap(m_capacity, s2.m_capacity);
+        std::swap(m_buffer, s2.m_buffer);
+        std::swap(m_x, s2.m_x);
+        std::swap(m_y, s2.m_y);
+        std::swap(m_z, s2.m_z);
+        return *this;
+    }
+
+    void Vector3fStream::Resize(size_t count)
+    {
+        float *components[] = { m_x, m_y, m_z };
+        resizeComponents(m_buffer, components, 3, m_size, m_capacity, count);
+        m_x = components[0];
+        m_y = components[1];
+        m_z = components[2];
+    }
+
+    void Vector3fStream::Load(const Vector3f *v, size_t count)
+    {
+        Resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            Set(i, v[i]);
+    }
+
+    void Vector3fStream::Store(Vector3f *v) const
+    {
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            v[i].m_x = m_x[i];
+            v[i].m_y = m_y[i];
+            v[i].m_z = m_z[i];
+        }
+    }
+
+/*
+ * Vector4fStream
+ */
+    Vector4fStream::Vector4fStream(size_t count)
+    {
+        Resize(count);
+    }
+
+    Vector4fStream::Vector4fStream(const Vector4f *v, size_t count)
+    {
+        Load(v, count);
+    }
+
+    Vector4fStream::Vector4fStream(const Vector4fStream &s2)
+    {
+        *this = s2;
+    }
+
+    Vector4fStream::Vector4fStream(Vector4fStream &&s2)
+    {
+        *this = std::move(s2);
+    }
+
+    Vector4fStream::~Vector4fStream()
+    {
+        delete[] m_buffer;
+    }
+
+    Vector4fStream &Vector4fStream::operator=(const Vector4fStream &s2)
+    {
+        if (this != &s2)
+        {
+            Resize(s2.m_size);
+            if (m_size == 0)
+                return *this;
+
+            memcpy(m_x, s2.m_x, m_size * sizeof(float));
+            memcpy(m_y, s2.m_y, m_size * sizeof(float));
+            memcpy(m_z, s2.m_z, m_size * sizeof(float));
+            memcpy(m_w, s2.m_w, m_size * sizeof(float));
+        }
+
+        return *this;
+    }
+
+    Vector4fStream &Vector4fStream::operator=(Vector4fStream &&s2)
+    {
+        std::swap(m_size, s2.m_size);
+        std::swap(m_capacity, s2.m_capacity);
+        std::swap(m_buffer, s2.m_buffer);
+        std::swap(m_x, s2.m_x);
+        std::swap(m_y, s2.m_y);
+        std::swap(m_z, s2.m_z);
+        std::swap(m_w, s2.m_w);
+        return *this;
+    }
+
+    void Vector4fStream::Resize(size_t count)
+    {
+        float *components[] = { m_x, m_y, m_z, m_w };
+        resizeComponents(m_buffer, components, 4, m_size, m_capacity, count);
+        m_x = components[0];
+        m_y = components[1];
+        m_z = components[2];
+        m_w = components[3];
+    }
+
+    void Vector4fStream::Load(const Vector4f *v, size_t count)
+    {
+        Resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            Set(i, v[i]);
+    }
+
+    void Vector4fStream::Store(Vector4f *v) const
+    {
+        for (size_t i = 0; i < m_size; ++i)
+            v[i] = Get(i);
+    }
+
+/*
+ * Bulk operations - every loop runs over whole SIMD registers, reading/writing into the padding past Size()
+ */
+    using namespace Simd;
+
+    void Normalize(Vector3fStream &v, RsqrtAccuracy accuracy)
+    {
+        float *x = v.X();
+        float *y = v.Y();
+        float *z = v.Z();
+
+        for (size_t i = 0; i < v.Size(); i += LaneCount)
+        {
+            Lanes vx = Load(x + i);
+            Lanes vy = Load(y + i);
+            Lanes vz = Load(z + i);
+
+            Lanes len2 = MulAdd(vz, vz, MulAdd(vy, vy, Mul(vx, vx)));
+            Lanes invLen = KeepIfPositive(len2, InverseSqrt(len2, accuracy));
+            // zero-length vectors get a factor of 0, which keeps them at zero
+            Store(x + i, Mul(vx, invLen));
+            Store(y + i, Mul(vy, invLen));
+            Store(z + i, Mul(vz, invLen));
+        }
+    }
+
+    void Dot(const Vector3fStream &a, const Vector3fStream &b, float *out)
+    {
+        assert(b.Size() >= a.Size());
+        size_t n = a.Size();
+
+        for (size_t i = 0; i < n; i += LaneCount)
+        {
+            Lanes d = Mul(Load(a.X() + i), Load(b.X() + i));
+            d = MulAdd(Load(a.Y() + i), Load(b.Y() + i), d);
+            d = MulAdd(Load(a.Z() + i), Load(b.Z() + i), d);
+
+            // out is a plain array without padding or alignment guarantees
+            alignas(32) float result[LaneCount];
+            Store(result, d);
+            memcpy(out + i, result, (n - i < LaneCount ? n - i : LaneCount) * sizeof(float));
+        }
+    }
+
+    void Cross(const Vector3fStream &a, const Vector3fStream &b, Vector3fStream &out)
+    {
+        assert(b.Size() >= a.Size());
+        out.Resize(a.Size());
+
+        for (size_t i = 0; i < a.Size(); i += LaneCount)
+        {
+            Lanes ax = Load(a.X() + i), ay = Load(a.Y() + i), az = Load(a.Z() + i);
+            Lanes bx = Load(b.X() + i), by = Load(b.Y() + i), bz = Load(b.Z() + i);
+
+            Store(out.X() + i, Sub(Mul(ay, bz), Mul(az, by)));
+            Store(out.Y() + i, Sub(Mul(az, bx), Mul(ax, bz)));
+            Store(out.Z() + i, Sub(Mul(ax, by), Mul(ay, bx)));
+        }
+    }
+
+    void Lerp(const Vector3fStream &a, const Vector3fStream &b, float t, Vector3fStream &out)
+    {
+        assert(b.Size() >= a.Size());
+        out.Resize(a.Size());
+        Lanes vt = Set1(t);
+
+        for (size_t i = 0; i < a.Size(); i += LaneCount)
+        {
+            Lanes ax = Load(a.X() + i), ay = Load(a.Y() + i), az = Load(a.Z() + i);
+
+            Store(out.X() + i, MulAdd(Sub(Load(b.X() + i), ax), vt, ax));
+            Store(out.Y() + i, MulAdd(Sub(Load(b.Y() + i), ay), vt, ay));
+            Store(out.Z() + i, MulAdd(Sub(Load(b.Z() + i), az), vt, az));
+        }
+    }
+
+    void Transform(const Matrix4f &matrix, const Vector3fStream &in, Vector4fStream &out)
+    {
+        out.Resize(in.Size());
+
+        Lanes m[16];
+        for (int j = 0; j < 16; ++j)
+            m[j] = Set1(matrix[j]);
+
+        float *dst[] = { out.X(), out.Y(), out.Z(), out.W() };
+
+        for (size_t i = 0; i < in.Size(); i += LaneCount)
+        {
+            Lanes x = Load(in.X() + i);
+            Lanes y = Load(in.Y() + i);
+            Lanes z = Load(in.Z() + i);
+
+            // column vector layout, as Matrix4f * Vector4f: component r is x * m[r] + y * m[4 + r] + z * m[8 + r] + m[12 + r]
+            for (int r = 0; r < 4; ++r)
+                Store(dst[r] + i, Add(MulAdd(z, m[8 + r], MulAdd(y, m[4 + r], Mul(x, m[r]))), m[12 + r]));
+        }
+    }
+
+    // v' = v + w * t + u x t, where t = 2 * (u x v)
+    void Rotate(const Quaternion &q, const Vector3fStream &in, Vector3fStream &out)
+    {
+        out.Resize(in.Size());
+
+        Lanes ux = Set1(q.m_x);
+        Lanes uy = Set1(q.m_y);
+        Lanes uz = Set1(q.m_z);
+        Lanes w  = Set1(q.m_w);
+        Lanes two = Set1(2.f);
+
+        for (size_t i = 0; i < in.Size(); i += LaneCount)
+        {
+            Lanes vx = Load(in.X() + i), vy = Load(in.Y() + i), vz = Load(in.Z() + i);
+
+            Lanes tx = Mul(two, Sub(Mul(uy, vz), Mul(uz, vy)));
+            Lanes ty = Mul(two, Sub(Mul(uz, vx), Mul(ux, vz)));
+            Lanes tz = Mul(two, Sub(Mul(ux, vy), Mul(uy, vx)));
+
+            Store(out.X() + i, Add(MulAdd(w, tx, vx), Sub(Mul(uy, tz), Mul(uz, ty))));
+            Store(out.Y() + i, Add(MulAdd(w, ty, vy), Sub(Mul(uz, tx), Mul(ux, tz))));
+            Store(out.Z() + i, Add(MulAdd(w, tz, vz), Sub(Mul(ux, ty), Mul(uy, tx))));
+        }
+    }
+}
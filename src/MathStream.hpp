@@ -0,0 +1,105 @@
+#ifndef MATHSTREAM_INCLUDED
+#define MATHSTREAM_INCLUDED
+
+#include "Math.hpp"
+
+/*
+ * Structure-of-arrays vector containers and bulk operations working on them
+ */
+
+namespace Math
+{
+    // 3D vectors stored as separate x, y and z arrays
+    // components are 32-byte aligned and padded (with zeros) to a multiple of 8, so bulk loops never need a scalar tail
+    class Vector3fStream
+    {
+    public:
+        Vector3fStream() {}
+        explicit Vector3fStream(size_t count);
+        Vector3fStream(const Vector3f *v, size_t count);
+        Vector3fStream(const Vector3fStream &s2);
+        Vector3fStream(Vector3fStream &&s2);
+        ~Vector3fStream();
+
+        Vector3fStream &operator=(const Vector3fStream &s2);
+        Vector3fStream &operator=(Vector3fStream &&s2);
+
+        void Resize(size_t count);                // existing contents are preserved, dropped elements are zeroed
+        void Load(const Vector3f *v, size_t count); // resize and copy from an array of Vector3f
+        void Store(Vector3f *v) const;            // copy Size() elements to an array of Vector3f
+
+        Vector3f Get(size_t i) const { return Vector3f(m_x[i], m_y[i], m_z[i]); }
+        void Set(size_t i, const Vector3f &v) { m_x[i] = v.m_x; m_y[i] = v.m_y; m_z[i] = v.m_z; }
+
+        size_t Size() const { return m_size; }
+        size_t PaddedSize() const { return m_capacity; }
+
+        float *X() { return m_x; }
+        float *Y() { return m_y; }
+        float *Z() { return m_z; }
+        const float *X() const { return m_x; }
+        const float *Y() const { return m_y; }
+        const float *Z() const { return m_z; }
+
+    private:
+        size_t m_size = 0;
+        size_t m_capacity = 0;
+        float *m_buffer = nullptr; // single allocation holding all components
+        float *m_x = nullptr;
+        float *m_y = nullptr;
+        float *m_z = nullptr;
+    };
+
+    // 4D vectors stored as separate x, y, z and w arrays (same layout rules as Vector3fStream)
+    class Vector4fStream
+    {
+    public:
+        Vector4fStream() {}
+        explicit Vector4fStream(size_t count);
+        Vector4fStream(const Vector4f *v, size_t count);
+        Vector4fStream(const Vector4fStream &s2);
+        Vector4fStream(Vector4fStream &&s2);
+        ~Vector4fStream();
+
+        Vector4fStream &operator=(const Vector4fStream &s2);
+        Vector4fStream &operator=(Vector4fStream &&s2);
+
+        void Resize(size_t count);
+        void Load(const Vector4f *v, size_t count);
+        void Store(Vector4f *v) const;
+
+        Vector4f Get(size_t i) const { return Vector4f(m_x[i], m_y[i], m_z[i], m_w[i]); }
+        void Set(size_t i, const Vector4f &v) { m_x[i] = v.m_x; m_y[i] = v.m_y; m_z[i] = v.m_z; m_w[i] = v.m_w; }
+
+        size_t Size() const { return m_size; }
+        size_t PaddedSize() const { return m_capacity; }
+
+        float *X() { return m_x; }
+        float *Y() { return m_y; }
+        float *Z() { return m_z; }
+        float *W() { return m_w; }
+        const float *X() const { return m_x; }
+        const float *Y() const { return m_y; }
+        const float *Z() const { return m_z; }
+        const float *W() const { return m_w; }
+
+    private:
+        size_t m_size = 0;
+        size_t m_capacity = 0;
+        float *m_buffer = nullptr;
+        float *m_x = nullptr;
+        float *m_y = nullptr;
+        float *m_z = nullptr;
+        float *m_w = nullptr;
+    };
+
+    // bulk operations - output streams are resized to match the input, and may be the same object as an input
+    // (binary operations process a.Size() elements, so b must hold at least as many)
+    void Normalize(Vector3fStream &v, RsqrtAccuracy accuracy = RsqrtExact); // zero-length vectors are left as they are
+    void Dot(const Vector3fStream &a, const Vector3fStream &b, float *out); // out holds a.Size() floats
+    void Cross(const Vector3fStream &a, const Vector3fStream &b, Vector3fStream &out);
+    void Lerp(const Vector3fStream &a, const Vector3fStream &b, float t, Vector3fStream &out);
+    void Transform(const Matrix4f &matrix, const Vector3fStream &in, Vector4fStream &out); // points (w = 1), as matrix * Vector4f
+    void Rotate(const Quaternion &q, const Vector3fStream &in, Vector3fStream &out);      // unit q, vector length is preserved
+}
+#endif
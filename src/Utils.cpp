@@ -1,4 +1,7 @@
 #include "Utils.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
 #ifdef _WIN32
 #include <Windows.h>
 #endif
@@ -21,3 +24,30 @@ void Break()
     abort();
 #endif
 }
+
+bool WriteFileAtomic(const char *path, const void *data, size_t size)
+{
+    std::string tmpPath = std::string(path) + ".tmp";
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.write((const char *)data, size) || !file.flush())
+        {
+            file.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    // rename() doesn't replace existing files on Windows
+    if (std::rename(tmpPath.c_str(), path) != 0)
+    {
+        std::remove(path);
+        if (std::rename(tmpPath.c_str(), path) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
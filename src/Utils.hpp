@@ -25,4 +25,6 @@
 
 void LogError(const char *msg);
 void Break();
+// write to a temporary file first and rename it over path, so that an interrupted write never leaves a truncated file behind
+bool WriteFileAtomic(const char *path, const void *data, size_t size);
 #endif
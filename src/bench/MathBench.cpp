@@ -0,0 +1,546 @@
+#include "Math.hpp"
+#include "MathFrustum.hpp"
+#include "MathSIMD.hpp"
+#include "MathStream.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+ * Math library microbenchmarks (linux: make bench-math)
+ *
+ * Every kernel is timed over several batch sizes, with the optimized (SIMD) version checked
+ * against its plain C++ counterpart from Math::Scalar (or the exact path) before timing.
+ *
+ * Options:
+ *   --filter <text>      only run benchmarks with <text> in their name
+ *   --save <file>        write ns/op of every run to <file>
+ *   --baseline <file>    compare against a file written by --save and fail on regressions
+ *   --tolerance <pct>    allowed slowdown against the baseline (default: 15)
+ *
+ * The exit code is nonzero if a parity check fails or a benchmark regressed past the tolerance.
+ */
+
+using namespace Math;
+
+static const size_t s_batchSizes[] = { 4, 64, 1024, 16384 };
+static const double s_minRunTime   = 0.02; // seconds per timed run
+static const int    s_numRuns      = 5;    // best of
+
+struct BenchResult
+{
+    std::string m_name;
+    size_t      m_batch = 0;
+    double      m_nsPerOp = 0.0;
+};
+
+static std::vector<BenchResult> s_results;
+static const char *s_filter = nullptr;
+static int   s_parityFailures = 0;
+static float s_sink = 0.f; // keeps results observable so the timed loops aren't optimized away
+
+static float randomFloat(float minVal, float maxVal)
+{
+    return minVal + (maxVal - minVal) * (float)rand() / (float)RAND_MAX;
+}
+
+static Vector3f randomVector(float range)
+{
+    return Vector3f(randomFloat(-range, range), randomFloat(-range, range), randomFloat(-range, range));
+}
+
+static Quaternion randomRotation()
+{
+    Vector3f axis = randomVector(1.f);
+    axis.m_x += 0.01f; // never zero length
+    axis.Normalize();
+    return Quaternion(axis, randomFloat(-3.f, 3.f));
+}
+
+// well conditioned affine transform: rotation * scale + translation
+static Matrix4f randomTransform()
+{
+    Matrix4f m = randomRotation().ToMatrix();
+    Scale(m, randomFloat(0.5f, 2.f), randomFloat(0.5f, 2.f), randomFloat(0.5f, 2.f));
+    m[12] = randomFloat(-10.f, 10.f);
+    m[13] = randomFloat(-10.f, 10.f);
+    m[14] = randomFloat(-10.f, 10.f);
+    return m;
+}
+
+static bool selected(const char *name)
+{
+    return !s_filter || strstr(name, s_filter);
+}
+
+// time fn(batch) - fn processes batch elements per call, the result is the best per-element time of several runs
+template<typename Fn>
+static void bench(const char *name, size_t batch, Fn fn)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    fn(batch);
+
+    size_t iterations = 1;
+    double best = 0.0;
+
+    for (int run = 0; run < s_numRuns; ++run)
+    {
+        double elapsed = 0.0;
+        for (;;)
+        {
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+                fn(batch);
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (elapsed >= s_minRunTime)
+                break;
+            iterations *= 2;
+        }
+
+        double nsPerOp = elapsed * 1e9 / double(iterations * batch);
+        if (run == 0 || nsPerOp < best)
+            best = nsPerOp;
+    }
+
+    printf("%-34s %8zu %10.2f %10.1f\n", name, batch, best, 1e3 / best);
+
+    BenchResult result;
+    result.m_name = name;
+    result.m_batch = batch;
+    result.m_nsPerOp = best;
+    s_results.push_back(result);
+}
+
+// relative comparison - against scale[i] if given, otherwise against the result itself with values below 1 compared absolutely.
+// Kernels summing products should pass the magnitude of the summed terms as scale: FMA rounds those sums differently
+// from the scalar code, and the difference is relative to the terms, not to a result that may have cancelled down to near zero
+static bool parity(const char *name, const float *a, const float *b, size_t n, float tolerance, const float *scale = nullptr)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        float diff = fabsf(a[i] - b[i]);
+        float limit = scale ? tolerance * scale[i] : tolerance * (fabsf(b[i]) > 1.f ? fabsf(b[i]) : 1.f);
+
+        if (!(diff <= limit))
+        {
+            printf("PARITY FAILED: %s - element %zu: %g vs %g (tolerance %g)\n", name, i, a[i], b[i], limit);
+            s_parityFailures++;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+static bool parity(const char *name, const std::vector<T> &a, const std::vector<T> &b, float tolerance, const std::vector<T> *scale = nullptr)
+{
+    return parity(name, &a[0].m_x, &b[0].m_x, a.size() * sizeof(T) / sizeof(float), tolerance, scale ? &(*scale)[0].m_x : nullptr);
+}
+
+static bool parity(const char *name, const std::vector<Matrix4f> &a, const std::vector<Matrix4f> &b, float tolerance, const std::vector<Matrix4f> *scale = nullptr)
+{
+    return parity(name, a[0].m_m, b[0].m_m, a.size() * 16, tolerance, scale ? (*scale)[0].m_m : nullptr);
+}
+
+static Matrix4f absolute(const Matrix4f &m)
+{
+    Matrix4f result;
+    for (int i = 0; i < 16; ++i)
+        result[i] = fabsf(m[i]);
+    return result;
+}
+
+static Vector3f absolute(const Vector3f &v)
+{
+    return Vector3f(fabsf(v.m_x), fabsf(v.m_y), fabsf(v.m_z));
+}
+
+template<typename T>
+static void sink(const std::vector<T> &v)
+{
+    s_sink += (&v[0].m_x)[0] + (&v.back().m_x)[0];
+}
+
+static void sink(const std::vector<Matrix4f> &v)
+{
+    s_sink += v[0].m_m[0] + v.back().m_m[15];
+}
+
+/*
+ * Benchmarks
+ */
+static void benchMatrices(size_t n)
+{
+    std::vector<Matrix4f> a(n), b(n), ref(n), out(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        a[i] = randomTransform();
+        b[i] = randomTransform();
+    }
+
+    const Matrix4f &m = b[0];
+
+    if (selected("matrix multiply"))
+    {
+        std::vector<Matrix4f> scale(n);
+        MultiplyMatrices(a.data(), m, out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ref[i] = Scalar::Multiply(a[i], m);
+            scale[i] = Scalar::Multiply(absolute(a[i]), absolute(m));
+        }
+        parity("matrix multiply", out, ref, 1e-5f, &scale);
+
+        bench("matrix multiply/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) out[i] = Scalar::Multiply(a[i], m); sink(out); });
+        bench("matrix multiply/simd", n, [&](size_t k) { MultiplyMatrices(a.data(), m, out.data(), k); sink(out); });
+        bench("matrix multiply/operator", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) out[i] = a[i] * b[i]; sink(out); });
+    }
+
+    if (selected("matrix transpose"))
+    {
+        out = a;
+        ref = a;
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i].Transpose();
+            Scalar::Transpose(ref[i]);
+        }
+        parity("matrix transpose", out, ref, 0.f);
+
+        bench("matrix transpose/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) Scalar::Transpose(out[i]); sink(out); });
+        bench("matrix transpose/simd", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) out[i].Transpose(); sink(out); });
+    }
+
+    if (selected("matrix invert"))
+    {
+        InvertMatrices(a.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ref[i] = a[i];
+            Scalar::Invert(ref[i]);
+        }
+        parity("matrix invert", out, ref, 1e-4f);
+
+        InvertAffineMatrices(a.data(), out.data(), n);
+        parity("matrix invert affine", out, ref, 1e-4f);
+
+        bench("matrix invert/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) { out[i] = a[i]; Scalar::Invert(out[i]); } sink(out); });
+        bench("matrix invert/simd", n, [&](size_t k) { InvertMatrices(a.data(), out.data(), k); sink(out); });
+        bench("matrix invert affine/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) { out[i] = a[i]; Scalar::InvertAffine(out[i]); } sink(out); });
+        bench("matrix invert affine/simd", n, [&](size_t k) { InvertAffineMatrices(a.data(), out.data(), k); sink(out); });
+    }
+
+    if (selected("matrix transform points"))
+    {
+        std::vector<Vector3f> points(n);
+        std::vector<Vector3f> absPoints(n);
+        std::vector<Vector4f> out4(n), ref4(n), scale4(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            points[i] = randomVector(100.f);
+            absPoints[i] = absolute(points[i]);
+        }
+
+        TransformPoints(m, points.data(), out4.data(), n);
+        Scalar::TransformPoints(m, points.data(), ref4.data(), n);
+        Scalar::TransformPoints(absolute(m), absPoints.data(), scale4.data(), n);
+        parity("matrix transform points", out4, ref4, 1e-5f, &scale4);
+
+        // Vector3f overload is the same point transform, minus w
+        std::vector<Vector3f> out3(n), ref3(n), scale3(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out3[i] = m * points[i];
+            ref3[i] = Vector3f(ref4[i].m_x, ref4[i].m_y, ref4[i].m_z);
+            scale3[i] = Vector3f(scale4[i].m_x, scale4[i].m_y, scale4[i].m_z);
+        }
+        parity("matrix transform points vector3", out3, ref3, 1e-5f, &scale3);
+
+        Vector4fStream clipStream;
+        Transform(m, Vector3fStream(points.data(), n), clipStream);
+        clipStream.Store(out4.data());
+        parity("matrix transform points stream", out4, ref4, 1e-5f, &scale4);
+
+        // transformed points have to land in the clip volume exactly when the frustum extracted from the same matrix contains them
+        Matrix4f view, projection;
+        MakeView(view, Vector3f(0.f, 0.f, 150.f), Vector3f(0.f, 0.f, -1.f), Vector3f(0.f, 1.f, 0.f));
+        MakePerspective(projection, 1.2f, 1.333f, 0.1f, 300.f);
+        ApplyVulkanClipCorrection(projection);
+
+        Matrix4f viewProjection = view * projection;
+        Frustum frustum(viewProjection);
+        TransformPoints(viewProjection, points.data(), out4.data(), n);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Vector4f &c = out4[i];
+            float margin = std::min(std::min(c.m_w - fabsf(c.m_x), c.m_w - fabsf(c.m_y)), std::min(c.m_z, c.m_w - c.m_z));
+
+            // too close to a plane to tell apart from rounding
+            if (fabsf(margin) < 1e-3f * fabsf(c.m_w))
+                continue;
+
+            if ((margin > 0.f) != frustum.ContainsPoint(points[i]))
+            {
+                printf("PARITY FAILED: matrix transform points frustum - element %zu: clip (%g, %g, %g, %g) disagrees with the frustum\n", i, c.m_x, c.m_y, c.m_z, c.m_w);
+                s_parityFailures++;
+                break;
+            }
+        }
+
+        bench("matrix transform points/scalar", n, [&](size_t k) { Scalar::TransformPoints(m, points.data(), out4.data(), k); sink(out4); });
+        bench("matrix transform points/simd", n, [&](size_t k) { TransformPoints(m, points.data(), out4.data(), k); sink(out4); });
+    }
+}
+
+static void benchBuilders(size_t n)
+{
+    std::vector<Matrix4f> out(n);
+    std::vector<Vector3f> eyes(n);
+    for (size_t i = 0; i < n; ++i)
+        eyes[i] = randomVector(50.f);
+
+    if (selected("make view"))
+    {
+        const Vector3f target(0.f, 0.f, 0.f);
+        const Vector3f up(0.f, 1.f, 0.f);
+        bench("make view", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) MakeView(out[i], eyes[i], target, up); sink(out); });
+    }
+
+    if (selected("make perspective"))
+    {
+        bench("make perspective", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) MakePerspective(out[i], 1.f + eyes[i].m_x * 0.01f, 1.333f, 0.1f, 1000.f); sink(out); });
+    }
+}
+
+static void benchQuaternions(size_t n)
+{
+    std::vector<Quaternion> q(n), q2(n), outQ(n);
+    std::vector<Vector3f> v(n), out(n), ref(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        q[i] = randomRotation();
+        q2[i] = randomRotation();
+        v[i] = randomVector(10.f);
+    }
+
+    if (selected("quaternion rotate"))
+    {
+        // rotation keeps the length, which bounds every term summed into a component
+        std::vector<Vector3f> scale(n);
+        RotateVectors(q.data(), v.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ref[i] = Scalar::Rotate(q[i], v[i]);
+            float length = v[i].Length();
+            scale[i] = Vector3f(length, length, length);
+        }
+        parity("quaternion rotate", out, ref, 1e-5f, &scale);
+
+        bench("quaternion rotate/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) out[i] = Scalar::Rotate(q[i], v[i]); sink(out); });
+        bench("quaternion rotate/operator", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) out[i] = q[i] * v[i]; sink(out); });
+        bench("quaternion rotate/simd", n, [&](size_t k) { RotateVectors(q.data(), v.data(), out.data(), k); sink(out); });
+        bench("quaternion rotate one/simd", n, [&](size_t k) { RotateVectors(q[0], v.data(), out.data(), k); sink(out); });
+    }
+
+    if (selected("quaternion multiply"))
+        bench("quaternion multiply", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) outQ[i] = q[i] * q2[i]; sink(outQ); });
+
+    if (selected("quaternion slerp"))
+    {
+        bench("quaternion slerp", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) outQ[i] = Slerp(q[i], q2[i], 0.3f); sink(outQ); });
+        bench("quaternion nlerp", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) outQ[i] = Nlerp(q[i], q2[i], 0.3f); sink(outQ); });
+    }
+}
+
+static void benchNormalize(size_t n)
+{
+    std::vector<Vector3f> v(n), out(n), ref(n);
+    std::vector<Quaternion> q(n), outQ(n), refQ(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        v[i] = randomVector(10.f);
+        q[i] = Quaternion(randomFloat(-2.f, 2.f), randomFloat(-2.f, 2.f), randomFloat(-2.f, 2.f), randomFloat(-2.f, 2.f));
+        ref[i] = v[i];
+        ref[i].Normalize();
+        refQ[i] = q[i];
+        refQ[i].Normalize();
+    }
+
+    // normalizing already normalized data would hide denormal/range effects, so every call starts from the raw input
+    if (selected("normalize vector"))
+    {
+        static const char *names[] = { "normalize vector estimate", "normalize vector refined", "normalize vector exact" };
+        static const float tolerances[] = { 2e-3f, 1e-5f, 1e-6f };
+
+        for (int a = RsqrtEstimate; a <= RsqrtExact; ++a)
+        {
+            out = v;
+            NormalizeVectors(out.data(), n, RsqrtAccuracy(a));
+            parity(names[a], out, ref, tolerances[a]);
+
+            out = v;
+            for (size_t i = 0; i < n; ++i)
+                out[i].QuickNormalize(RsqrtAccuracy(a));
+            parity(names[a], out, ref, tolerances[a]);
+        }
+
+        bench("normalize vector/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) { out[i] = v[i]; out[i].Normalize(); } sink(out); });
+        bench("normalize vector/quick", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) { out[i] = v[i]; out[i].QuickNormalize(); } sink(out); });
+        bench("normalize vector/simd estimate", n, [&](size_t k) { std::copy(v.begin(), v.begin() + k, out.begin()); NormalizeVectors(out.data(), k, RsqrtEstimate); sink(out); });
+        bench("normalize vector/simd refined", n, [&](size_t k) { std::copy(v.begin(), v.begin() + k, out.begin()); NormalizeVectors(out.data(), k, RsqrtRefined); sink(out); });
+        bench("normalize vector/simd exact", n, [&](size_t k) { std::copy(v.begin(), v.begin() + k, out.begin()); NormalizeVectors(out.data(), k, RsqrtExact); sink(out); });
+
+        Vector3fStream raw(v.data(), n);
+        Vector3fStream stream = raw;
+        Normalize(stream, RsqrtRefined);
+        stream.Store(out.data());
+        parity("normalize vector stream", out, ref, tolerances[RsqrtRefined]);
+
+        bench("normalize vector/stream refined", n, [&](size_t k) { stream = raw; Normalize(stream, RsqrtRefined); s_sink += stream.X()[k - 1]; });
+    }
+
+    if (selected("normalize quaternion"))
+    {
+        outQ = q;
+        NormalizeQuaternions(outQ.data(), n, RsqrtRefined);
+        parity("normalize quaternion", outQ, refQ, 1e-5f);
+
+        bench("normalize quaternion/scalar", n, [&](size_t k) { for (size_t i = 0; i < k; ++i) { outQ[i] = q[i]; outQ[i].Normalize(); } sink(outQ); });
+        bench("normalize quaternion/simd refined", n, [&](size_t k) { std::copy(q.begin(), q.begin() + k, outQ.begin()); NormalizeQuaternions(outQ.data(), k, RsqrtRefined); sink(outQ); });
+    }
+}
+
+/*
+ * Baselines
+ */
+static bool saveResults(const char *fileName)
+{
+    FILE *f = fopen(fileName, "w");
+    if (!f)
+    {
+        printf("Could not write %s\n", fileName);
+        return false;
+    }
+
+    for (const BenchResult &r : s_results)
+        fprintf(f, "%s|%zu|%f\n", r.m_name.c_str(), r.m_batch, r.m_nsPerOp);
+
+    fclose(f);
+    return true;
+}
+
+// returns the number of benchmarks slower than the baseline by more than tolerance percent
+static int compareResults(const char *fileName, double tolerance)
+{
+    FILE *f = fopen(fileName, "r");
+    if (!f)
+    {
+        printf("Could not read baseline %s\n", fileName);
+        return 1;
+    }
+
+    int regressions = 0;
+    char line[256];
+
+    printf("\nComparing against %s (tolerance %.0f%%)\n", fileName, tolerance);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *sep1 = strchr(line, '|');
+        char *sep2 = sep1 ? strchr(sep1 + 1, '|') : nullptr;
+        if (!sep2)
+            continue;
+
+        *sep1 = '\0';
+        size_t batch = strtoul(sep1 + 1, nullptr, 10);
+        double baseline = strtod(sep2 + 1, nullptr);
+
+        for (const BenchResult &r : s_results)
+        {
+            if (r.m_name != line || r.m_batch != batch)
+                continue;
+
+            double change = (r.m_nsPerOp / baseline - 1.0) * 100.0;
+            if (change > tolerance)
+            {
+                printf("REGRESSION: %-34s %8zu %10.2f -> %.2f ns/op (%+.1f%%)\n", line, batch, baseline, r.m_nsPerOp, change);
+                regressions++;
+            }
+        }
+    }
+
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *saveFile = nullptr;
+    const char *baselineFile = nullptr;
+    double tolerance = 15.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            s_filter = argv[++i];
+        else if (!strcmp(argv[i], "--save") && i + 1 < argc)
+            saveFile = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else
+        {
+            printf("Usage: %s [--filter text] [--save file] [--baseline file] [--tolerance percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+#if defined(MATH_SIMD_AVX)
+    printf("Math backend: AVX\n\n");
+#elif defined(MATH_SIMD_SSE)
+    printf("Math backend: SSE\n\n");
+#else
+    printf("Math backend: scalar\n\n");
+#endif
+    printf("%-34s %8s %10s %10s\n", "benchmark", "batch", "ns/op", "Mop/s");
+
+    srand(1234);
+    for (size_t batch : s_batchSizes)
+    {
+        benchMatrices(batch);
+        benchBuilders(batch);
+        benchQuaternions(batch);
+        benchNormalize(batch);
+    }
+
+    int failures = s_parityFailures;
+    if (failures)
+        printf("\n%d parity check(s) failed\n", failures);
+
+    if (saveFile && !saveResults(saveFile))
+        failures++;
+
+    if (baselineFile)
+    {
+        int regressions = compareResults(baselineFile, tolerance);
+        if (regressions)
+            printf("%d benchmark(s) regressed\n", regressions);
+        else
+            printf("No regressions\n");
+
+        failures += regressions;
+    }
+
+    // printed so the compiler has to keep every result
+    printf("\n(checksum %g)\n", s_sink);
+    return failures ? 1 : 0;
+}
@@ -2,7 +2,11 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/CameraDirector.hpp"
+#include "FrameTimer.hpp"
 #include "Utils.hpp"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
 
 // for simplicity, let's use globals
 RenderContext  g_renderContext;
@@ -11,6 +15,56 @@ CameraDirector g_cameraDirector;
 
 int main(int argc, char **argv)
 {
+    // -maxfps <fps>: cap the frame rate, -frames <1-4>: number of frames in flight
+    // -binarysync: use binary semaphores and fences even if timeline semaphores are supported
+    // -renderpasses: use render passes even if dynamic rendering is supported, -noimageless: one framebuffer per swapchain image
+    // -nopipelinelibrary: build monolithic pipelines even if graphics pipeline libraries are supported
+    // -nodynamicstate: one pipeline per cull mode, topology, depth, blend and sample count combination even if extended dynamic state is supported
+    // -present <fifo|relaxed|mailbox|immediate>: preferred present mode, -images <n>: swapchain image count, -maxqueued <n>: frame latency limit
+    // -latelatch: update the camera matrix from the latest mouse input right before submission
+    // -nowarmup: don't precompile pipeline states recorded by earlier runs
+    double maxFps = 0.0;
+    int framesInFlight = 2;
+    int maxQueuedFrames = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-binarysync"))
+            g_renderContext.allowTimelineSemaphores = false;
+        else if (!strcmp(argv[i], "-renderpasses"))
+            g_renderContext.allowDynamicRendering = false;
+        else if (!strcmp(argv[i], "-noimageless"))
+            g_renderContext.allowImagelessFramebuffer = false;
+        else if (!strcmp(argv[i], "-nopipelinelibrary"))
+            g_renderContext.allowPipelineLibrary = false;
+        else if (!strcmp(argv[i], "-nodynamicstate"))
+            g_renderContext.allowDynamicState = false;
+        else if (!strcmp(argv[i], "-latelatch"))
+            g_renderContext.lateLatching = true;
+        else if (!strcmp(argv[i], "-nowarmup"))
+            g_renderContext.warmUpPipelines = false;
+        else if (i + 1 < argc && !strcmp(argv[i], "-maxfps"))
+            maxFps = atof(argv[i + 1]);
+        else if (i + 1 < argc && !strcmp(argv[i], "-frames"))
+            framesInFlight = atoi(argv[i + 1]);
+        else if (i + 1 < argc && !strcmp(argv[i], "-images"))
+            g_renderContext.swapChain.requestedImageCount = (uint32_t)std::max(0, atoi(argv[i + 1]));
+        else if (i + 1 < argc && !strcmp(argv[i], "-maxqueued"))
+            maxQueuedFrames = atoi(argv[i + 1]);
+        else if (i + 1 < argc && !strcmp(argv[i], "-present"))
+        {
+            const char *mode = argv[i + 1];
+            if (!strcmp(mode, "fifo"))
+                g_renderContext.swapChain.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            else if (!strcmp(mode, "relaxed"))
+                g_renderContext.swapChain.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            else if (!strcmp(mode, "mailbox"))
+                g_renderContext.swapChain.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            else if (!strcmp(mode, "immediate"))
+                g_renderContext.swapChain.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+    }
+
     // initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
     {
@@ -18,31 +72,47 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    if (!g_renderContext.Init("Vulkan Playground", 100, 100, 1024, 768))
+    if (!g_renderContext.Init("Vulkan Playground", 100, 100, 1024, 768, framesInFlight))
     {
         LOG_MESSAGE_ASSERT(false, "Could not initialize render context!");
         SDL_Quit();
         return 1;
     }
 
+    if (maxQueuedFrames > 0)
+        g_renderContext.SetMaxQueuedFrames(maxQueuedFrames);
+
+    // mouse look sampled again at submission - the rest of the simulation keeps its fixed step
+    g_renderContext.lateLatchUpdate = []() {
+        processMouseMotion();
+        g_renderContext.ModelViewProjectionMatrix = g_cameraDirector.GetActiveCamera()->ViewProjectionMatrix();
+    };
+
     SDL_ShowCursor(SDL_DISABLE);
     g_application.OnStart(argc, argv);
 
-    double now = 0, last = 0;
+    // simulation runs at a fixed rate, rendering as fast as possible unless capped
+    FrameTimer frameTimer(1.0 / 120.0);
+    frameTimer.SetFrameCap(maxFps);
+    frameTimer.Start();
 
     while (g_application.Running())
     {
+        // don't let the CPU run further ahead than the latency limit allows, so that input below is as fresh as possible
+        g_renderContext.WaitForFrameLatency();
+
         // handle key presses
         processEvents();
 
-        now = SDL_GetTicks();
-        float dt = float(now - last) / 1000.f;
+        for (int steps = frameTimer.Advance(); steps > 0; --steps)
+            g_application.OnUpdate((float)frameTimer.StepSize());
 
-        g_application.OnUpdate(dt);
-        g_renderContext.ModelViewProjectionMatrix = g_cameraDirector.GetActiveCamera()->ViewMatrix() * g_cameraDirector.GetActiveCamera()->ProjectionMatrix();
-        g_application.OnRender();
+        // render in between the last two simulation steps
+        g_cameraDirector.GetActiveCamera()->SetInterpolation(frameTimer.Alpha());
+        g_renderContext.ModelViewProjectionMatrix = g_cameraDirector.GetActiveCamera()->ViewProjectionMatrix();
+        g_application.OnRender((float)frameTimer.FrameTime());
 
-        last = now;
+        frameTimer.WaitForNextFrame();
     }
 
     g_application.OnTerminate();
@@ -8,32 +8,26 @@ static const float MouseSensitivity = 800.f;
 
 
 Camera::Camera(float x, float y, float z) : m_position(x, y, z),
+                                            m_prevPosition(x, y, z),
                                             m_yLimit(1.f),
                                             m_viewVector(0.0f, 0.0f, -1.0f),
                                             m_rightVector(1.0f, 0.0f, 0.0f),
                                             m_upVector(0.0f, 1.0f, 0.0f),
                                             m_rotation(0.0f, 0.0f, 0.0f)
 {
-    SetMode(CAM_DOF6);
 }
 
 Camera::Camera(const Math::Vector3f &position,
                const Math::Vector3f &up,
                const Math::Vector3f &right,
                const Math::Vector3f &view ) : m_position(position),
+                                              m_prevPosition(position),
                                               m_yLimit(1.f),
                                               m_viewVector(view),
                                               m_rightVector(right),
                                               m_upVector(up),
                                               m_rotation(0.0f, 0.0f, 0.0f)
 {
-    SetMode(CAM_DOF6);
-}
-
-void Camera::UpdateView()
-{
-    // view matrix
-    Math::MakeView(m_viewMatrix, m_position, m_viewVector, m_upVector);
 }
 
 void Camera::RotateCamera(float angle, float x, float y, float z)
@@ -44,40 +38,34 @@ void Camera::RotateCamera(float angle, float x, float y, float z)
 
 void Camera::RotateCamera(const Math::Quaternion &q)
 {
-    Math::Quaternion result;
-
-    Math::Quaternion viewQuat(m_viewVector.m_x,
-                              m_viewVector.m_y,
-                              m_viewVector.m_z,
-                              0);
-
-    result = ((q * viewQuat) * q.GetConjugate());
-
-    m_viewVector.m_x = result.m_x;
-    m_viewVector.m_y = result.m_y;
-    m_viewVector.m_z = result.m_z;
+    m_viewVector = q * m_viewVector;
+    ViewChanged();
 }
 
 void Camera::Move(const Math::Vector3f &Direction)
 {
     m_position = m_position + Direction;
+    ViewChanged();
 }
 
 
 void Camera::MoveForward(float Distance)
 {
     m_position = m_position + (m_viewVector * -Distance);
+    ViewChanged();
 }
 
 
 void Camera::MoveUpward(float Distance)
 {
     m_position = m_position + (m_upVector * Distance);
+    ViewChanged();
 }
 
 void Camera::Strafe(float Distance)
 {
     m_position = m_position + (m_rightVector * Distance);
+    ViewChanged();
 }
 
 void Camera::SetMode(CameraMode cm)
@@ -85,7 +73,7 @@ void Camera::SetMode(CameraMode cm)
     if (m_mode != cm)
     {
         m_mode = cm;
-        UpdateProjection();
+        ProjectionChanged();
     }
 }
 
@@ -112,15 +100,10 @@ void Camera::rotateZ(float angle)
     axis.QuickNormalize();
 
     Math::Quaternion rotQuat(axis, angle);
-    Math::Quaternion viewQuat(m_upVector.m_x, m_upVector.m_y, m_upVector.m_z, 0);
-
-    Math::Quaternion result = ((rotQuat * viewQuat) * rotQuat.GetConjugate());
-
-    m_upVector.m_x = result.m_x;
-    m_upVector.m_y = result.m_y;
-    m_upVector.m_z = result.m_z;
+    m_upVector = rotQuat * m_upVector;
 
     m_rightVector = m_upVector.CrossProduct(m_viewVector) * -1;
+    ViewChanged();
 }
 
 void Camera::OnMouseMove(int x, int y)
@@ -180,10 +163,53 @@ void Camera::OnMouseMove(int x, int y)
 
     m_rightVector = m_viewVector.CrossProduct(m_upVector);
     m_rightVector.QuickNormalize();
+    ViewChanged();
 }
 
-void Camera::UpdateProjection()
+void Camera::BeginStep()
 {
+    Math::Vector3f delta = m_position - m_prevPosition;
+    if (delta.DotProduct(delta) > 0.f)
+    {
+        m_prevPosition = m_position;
+        ViewChanged();
+    }
+}
+
+void Camera::SetInterpolation(float alpha)
+{
+    m_alpha = alpha;
+
+    // only rebuild if the eye actually moved - a camera standing still keeps its cached matrices
+    Math::Vector3f delta = InterpolatedPosition() - m_viewEye;
+    if (delta.DotProduct(delta) > 0.f)
+        ViewChanged();
+}
+
+const Math::Matrix4f &Camera::ViewMatrix() const
+{
+    if (m_dirty & DIRTY_VIEW)
+    {
+        m_viewEye = InterpolatedPosition();
+        Math::MakeView(m_viewMatrix, m_viewEye, m_viewVector, m_upVector);
+        m_dirty &= ~DIRTY_VIEW;
+    }
+
+    return m_viewMatrix;
+}
+
+const Math::Matrix4f &Camera::ProjectionMatrix() const
+{
+    // window resizes don't go through the camera, so catch them here
+    if (m_projectionRatio != g_renderContext.scrRatio)
+        ProjectionChanged();
+
+    if (!(m_dirty & DIRTY_PROJECTION))
+        return m_projectionMatrix;
+
+    m_projectionRatio = g_renderContext.scrRatio;
+    m_dirty &= ~DIRTY_PROJECTION;
+
     switch (m_mode)
     {
     case CAM_DOF6:
@@ -204,20 +230,71 @@ void Camera::UpdateProjection()
                                   g_renderContext.nearPlane,
                                   g_renderContext.farPlane);
         }
+
+        // convert projection matrix to Vulkan coordinate system
+        Math::ApplyVulkanClipCorrection(m_projectionMatrix);
         break;
     case CAM_ORTHO:
-        Math::MakeOrthogonal(m_projectionMatrix, g_renderContext.left, g_renderContext.right, g_renderContext.bottom, g_renderContext.top, 0.1f, 5.f);
+        m_projectionMatrix = OrthoMatrix();
         break;
     }
 
-    // Convert projection matrix to Vulkan coordinate system (https://matthewwellings.com/blog/the-new-vulkan-coordinate-system/)
-    Math::Matrix4f vulkanCorrection;
-    vulkanCorrection.Zero();
-    vulkanCorrection[0] = 1.f;
-    vulkanCorrection[5] = -1.f;
-    vulkanCorrection[10] = 0.5f;
-    vulkanCorrection[14] = 0.5f;
-    vulkanCorrection[15] = 1.f;
+    return m_projectionMatrix;
+}
+
+const Math::Matrix4f &Camera::ViewProjectionMatrix() const
+{
+    // refresh both sources first - either of them may flag the product as stale
+    const Math::Matrix4f &view = ViewMatrix();
+    const Math::Matrix4f &projection = ProjectionMatrix();
+
+    if (m_dirty & DIRTY_VIEW_PROJECTION)
+    {
+        m_viewProjectionMatrix = view * projection;
+        m_dirty &= ~DIRTY_VIEW_PROJECTION;
+    }
+
+    return m_viewProjectionMatrix;
+}
+
+const Math::Matrix4f &Camera::InverseViewMatrix() const
+{
+    const Math::Matrix4f &view = ViewMatrix();
+
+    if (m_dirty & DIRTY_INV_VIEW)
+    {
+        // MakeView produces rotation + translation only
+        m_inverseViewMatrix = view;
+        m_inverseViewMatrix.InvertOrthonormal();
+        m_dirty &= ~DIRTY_INV_VIEW;
+    }
+
+    return m_inverseViewMatrix;
+}
+
+const Math::Matrix4f &Camera::InverseViewProjectionMatrix() const
+{
+    const Math::Matrix4f &viewProjection = ViewProjectionMatrix();
+
+    if (m_dirty & DIRTY_INV_VIEW_PROJECTION)
+    {
+        m_inverseViewProjectionMatrix = viewProjection;
+        m_inverseViewProjectionMatrix.Invert();
+        m_dirty &= ~DIRTY_INV_VIEW_PROJECTION;
+    }
+
+    return m_inverseViewProjectionMatrix;
+}
+
+const Math::Matrix4f &Camera::OrthoMatrix() const
+{
+    // ortho bounds are derived from the screen ratio only
+    if (m_orthoRatio != g_renderContext.scrRatio)
+    {
+        m_orthoRatio = g_renderContext.scrRatio;
+        Math::MakeOrthogonal(m_orthoMatrix, g_renderContext.left, g_renderContext.right, g_renderContext.bottom, g_renderContext.top, 0.1f, 5.f);
+        Math::ApplyVulkanClipCorrection(m_orthoMatrix);
+    }
 
-    m_projectionMatrix = m_projectionMatrix * vulkanCorrection;
+    return m_orthoMatrix;
 }
@@ -24,7 +24,6 @@ public:
            const Math::Vector3f &right,
            const Math::Vector3f &view);
 
-    void UpdateView();
     void RotateCamera(float angle, float x, float y, float z);
     void RotateCamera(const Math::Quaternion &q);
     void Move(const Math::Vector3f &Direction);
@@ -43,9 +42,20 @@ public:
 
     void OnMouseMove(int x, int y);
 
-    void UpdateProjection();
-    const Math::Matrix4f &ProjectionMatrix() const { return m_projectionMatrix; }
-    const Math::Matrix4f &ViewMatrix() const { return m_viewMatrix; }
+    // fixed timestep support - BeginStep() stores the position reached by the previous simulation step and
+    // SetInterpolation() selects where between that and the current position to render from
+    // (orientation is driven by mouse events directly, so it's not interpolated)
+    void BeginStep();
+    void SetInterpolation(float alpha);
+
+    // matrices are cached and only rebuilt on access if the camera (or viewport aspect ratio) changed in between
+    const Math::Matrix4f &ViewMatrix() const;
+    const Math::Matrix4f &ProjectionMatrix() const;
+    const Math::Matrix4f &ViewProjectionMatrix() const; // ViewMatrix() * ProjectionMatrix()
+    const Math::Matrix4f &InverseViewMatrix() const;
+    const Math::Matrix4f &InverseViewProjectionMatrix() const;
+    // screen space projection (same as CAM_ORTHO) that can be used without switching camera mode
+    const Math::Matrix4f &OrthoMatrix() const;
 
     // manually specify vector values
     void SetRightVector(float x, float y, float z)
@@ -53,6 +63,7 @@ public:
         m_rightVector.m_x = x;
         m_rightVector.m_y = y;
         m_rightVector.m_z = z;
+        ViewChanged();
     }
 
     void SetUpVector(float x, float y, float z)
@@ -60,6 +71,7 @@ public:
         m_upVector.m_x = x;
         m_upVector.m_y = y;
         m_upVector.m_z = z;
+        ViewChanged();
     }
 
     void SetViewVector(float x, float y, float z)
@@ -67,13 +79,40 @@ public:
         m_viewVector.m_x = x;
         m_viewVector.m_y = y;
         m_viewVector.m_z = z;
+        ViewChanged();
     }
 private:
-    CameraMode     m_mode;
+    enum DirtyFlags
+    {
+        DIRTY_VIEW                = 1 << 0,
+        DIRTY_PROJECTION          = 1 << 1,
+        DIRTY_VIEW_PROJECTION     = 1 << 2,
+        DIRTY_INV_VIEW            = 1 << 3,
+        DIRTY_INV_VIEW_PROJECTION = 1 << 4,
+        DIRTY_ALL                 = (1 << 5) - 1
+    };
+
+    void ViewChanged() { m_dirty |= DIRTY_VIEW | DIRTY_VIEW_PROJECTION | DIRTY_INV_VIEW | DIRTY_INV_VIEW_PROJECTION; }
+    void ProjectionChanged() const { m_dirty |= DIRTY_PROJECTION | DIRTY_VIEW_PROJECTION | DIRTY_INV_VIEW_PROJECTION; }
+    Math::Vector3f InterpolatedPosition() const { return m_prevPosition + (m_position - m_prevPosition) * m_alpha; }
+
+    CameraMode     m_mode = CAM_DOF6;
     Math::Vector3f m_position;
+    Math::Vector3f m_prevPosition;
+    float          m_alpha = 1.f;
     float          m_yLimit;
-    Math::Matrix4f m_viewMatrix;
-    Math::Matrix4f m_projectionMatrix;
+
+    // cached matrices
+    mutable unsigned int   m_dirty = DIRTY_ALL;
+    mutable float          m_projectionRatio = 0.f; // screen ratio the projection was built for
+    mutable float          m_orthoRatio = 0.f;      // ...and the ortho matrix
+    mutable Math::Vector3f m_viewEye;               // interpolated position the view matrix was built from
+    mutable Math::Matrix4f m_viewMatrix;
+    mutable Math::Matrix4f m_projectionMatrix;
+    mutable Math::Matrix4f m_viewProjectionMatrix;
+    mutable Math::Matrix4f m_inverseViewMatrix;
+    mutable Math::Matrix4f m_inverseViewProjectionMatrix;
+    mutable Math::Matrix4f m_orthoMatrix;
 
     // camera orientation vectors
     Math::Vector3f m_viewVector;
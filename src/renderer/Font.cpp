@@ -21,7 +21,7 @@ Font::Font(const char *tex) : m_scale(1.f, 1.f), m_position(0.0f, 0.0f, 0.0f), m
     m_pipeline.cullMode  = VK_CULL_MODE_NONE;
     m_pipeline.topology  = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
     m_pipeline.blendMode = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    m_pipeline.cache     = g_renderContext.pipelineCache;
+    m_pipeline.cache     = &g_renderContext.pipelineCache;
     m_pipeline.depthTestEnable = VK_FALSE;
 
     // load font texture
@@ -34,8 +34,7 @@ Font::Font(const char *tex) : m_scale(1.f, 1.f), m_position(0.0f, 0.0f, 0.0f), m
     m_vbInfo.attributeDescriptions.push_back(vk::getAttributeDescription(inTexCoord, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3));
     m_vbInfo.attributeDescriptions.push_back(vk::getAttributeDescription(inColor, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 5));
 
-    // create vertex buffer and Vulkan descriptor
-    vk::createVertexBuffer(g_renderContext.device, &m_charBuffer, sizeof(Glyph) * MAX_CHARS, &m_vertexBuffer);
+    // create Vulkan descriptor (vertex data lives in per-frame transient memory)
     CreateDescriptor(*m_texture, &m_descriptor);
 
     RebuildPipeline();
@@ -43,11 +42,7 @@ Font::Font(const char *tex) : m_scale(1.f, 1.f), m_position(0.0f, 0.0f, 0.0f), m
 
 Font::~Font()
 {
-    vk::destroyPipeline(g_renderContext.device, m_pipeline);
-
-    vkDestroyDescriptorSetLayout(g_renderContext.device.logical, m_descriptor.setLayout, nullptr);
-    vkDestroyDescriptorPool(g_renderContext.device.logical, m_descriptor.pool, nullptr);
-    vk::freeBuffer(g_renderContext.device, m_vertexBuffer);
+    g_renderContext.DeferDestroy(m_descriptor);
 }
 
 void Font::RenderText(const std::string &text, float x, float y, float z, float r, float g, float b)
@@ -67,11 +62,11 @@ void Font::RenderText(const std::string &text)
 
 void Font::RenderText(const std::string &text, const Math::Vector3f &position, const Math::Vector3f &color)
 {
-    Camera::CameraMode camMode = g_cameraDirector.GetActiveCamera()->GetMode();
-    g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_ORTHO);
-
     Math::Vector3f pos = position;
 
+    if (!m_mappedData)
+        return;
+
     LOG_MESSAGE_ASSERT(m_charCount + text.length() < MAX_CHARS, "Too many chars");
     m_charCount += (int)text.length();
 
@@ -87,32 +82,29 @@ void Font::RenderText(const std::string &text, const Math::Vector3f &position, c
         pos.m_x += m_scale.m_x * (CHAR_SPACING / g_renderContext.scrRatio) * CHAR_WIDTH / g_renderContext.height;
         m_mappedData++;
     }
-
-    g_cameraDirector.GetActiveCamera()->SetMode(camMode);
 }
 
 void Font::RenderStart()
 {
-    // reset character counter and start mapping vertex buffer memory
+    // reset character counter and grab room for the maximum number of characters from this frame's memory
     m_charCount = 0;
-    vmaMapMemory(g_renderContext.device.allocator, m_vertexBuffer.allocation, (void**)&m_mappedData);
+    m_mappedData = (Glyph *)vk::allocateTransient(g_renderContext.activeFrame->transient, sizeof(Glyph) * MAX_CHARS, sizeof(float), &m_vertexOffset);
 }
 
 void Font::RenderFinish()
 {
-    vmaUnmapMemory(g_renderContext.device.allocator, m_vertexBuffer.allocation);
-
     // update command buffers with new characters
-    Draw();
+    if (m_mappedData)
+        Draw();
+
+    m_mappedData = nullptr;
 }
 
 void Font::RebuildPipeline()
 {
-    vk::destroyPipeline(g_renderContext.device, m_pipeline);
-
     // todo: pipeline derivatives https://github.com/SaschaWillems/Vulkan/blob/master/examples/pipelines/pipelines.cpp
     const char *shaders[] = { "res/Font_vert.spv", "res/Font_frag.spv" };
-    VK_VERIFY(vk::createPipeline(g_renderContext.device, g_renderContext.swapChain, g_renderContext.activeRenderPass, m_descriptor.setLayout, &m_vbInfo, &m_pipeline, shaders));
+    m_compiledPipeline = g_renderContext.CompilePipeline("font", m_descriptor.setLayout, &m_vbInfo, m_pipeline, shaders);
 }
 
 void Font::DrawChar(const Math::Vector3f &pos, int w, int h, int uo, int vo, int offset, const Math::Vector3f &color)
@@ -131,12 +123,13 @@ void Font::DrawChar(const Math::Vector3f &pos, int w, int h, int uo, int vo, int
     Math::Vector3f uv[4];
     Math::Vector3f p(pos.m_x, -pos.m_y, pos.m_z);
     Math::Vector3f uvo(texMatrix[12], texMatrix[13], 0.f);
+    Math::Matrix4f mvpMatrix = g_cameraDirector.GetActiveCamera()->OrthoMatrix() * mvMatrix;
     GlyphVertex g;
 
     for (int i = 0; i < 4; i++)
     {
         uv[i] = texMatrix * verts[i] + uvo;
-        verts[i] = g_cameraDirector.GetActiveCamera()->ProjectionMatrix() * mvMatrix * verts[i] + p;
+        verts[i] = mvpMatrix * verts[i] + p;
 
         memcpy(g.pos, &verts[i], sizeof(g.pos));
         memcpy(g.uv, &uv[i], sizeof(g.uv));
@@ -147,12 +140,16 @@ void Font::DrawChar(const Math::Vector3f &pos, int w, int h, int uo, int vo, int
 
 void Font::Draw()
 {
-    vkCmdBindPipeline(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.pipeline);
+    // text is dropped until the pipeline is compiled
+    const vk::Pipeline *pipeline = vk::readyPipeline(m_compiledPipeline);
+    if (!pipeline)
+        return;
+
+    vk::bindPipeline(g_renderContext.device, g_renderContext.activeCmdBuffer, *pipeline, g_renderContext.activeAttachments.sampleCount);
 
     // queue all pending characters
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(g_renderContext.activeCmdBuffer, 0, 1, &m_vertexBuffer.buffer, offsets);
-    vkCmdBindDescriptorSets(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.layout, 0, 1, &m_descriptor.set, 0, nullptr);
+    vkCmdBindVertexBuffers(g_renderContext.activeCmdBuffer, 0, 1, &g_renderContext.TransientBuffer().buffer, &m_vertexOffset);
+    vkCmdBindDescriptorSets(g_renderContext.activeCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, 1, &m_descriptor.set, 0, nullptr);
 
     for (int j = 0; j < m_charCount; j++)
         vkCmdDraw(g_renderContext.activeCmdBuffer, 4, 1, j * 4, 0);
@@ -56,14 +56,14 @@ private:
 
     // Vulkan buffers
     vk::Pipeline   m_pipeline;
+    vk::PipelineHandle m_compiledPipeline;
     vk::VertexBufferInfo m_vbInfo;
 
-    vk::Buffer     m_vertexBuffer;
     vk::Descriptor m_descriptor;
 
-    int    m_charCount = 0;         // number of characters currently queued for drawing
-    Glyph  m_charBuffer[MAX_CHARS]; // character data for vertex buffer
-    Glyph *m_mappedData = nullptr;  // pointer to currently mapped Vulkan data
+    int    m_charCount = 0;          // number of characters currently queued for drawing
+    Glyph *m_mappedData = nullptr;   // next glyph in this frame's transient memory
+    VkDeviceSize m_vertexOffset = 0; // offset of this frame's glyphs in the transient buffer
 };
 
 #endif
\ No newline at end of file
@@ -1,30 +1,68 @@
 #include "renderer/RenderContext.hpp"
 #include "renderer/vulkan/CmdBuffer.hpp"
 #include "renderer/vulkan/Pipeline.hpp"
+#include "renderer/vulkan/Sync.hpp"
 #include "renderer/vulkan/Validation.hpp"
 #include "renderer/TextureManager.hpp"
 #include "Utils.hpp"
 #include <algorithm>
+#include <fstream>
 
-// index of the command buffer that's currently in use
-static int s_currentCmdBuffer = 0;
+// per-frame memory for uniforms and dynamic vertex data
+static const VkDeviceSize TRANSIENT_MEMORY_SIZE = 256 * 1024;
+// draw buffer sizes are rounded up to this, so that drag-resizing a window doesn't reallocate them on every step
+static const uint32_t DRAW_BUFFER_GRANULARITY = 128;
 
-// Returns the maximum sample count usable by the platform
-static VkSampleCountFlagBits getMaxUsableSampleCount(const VkPhysicalDeviceProperties &deviceProperties)
+static const char *FXAA_SHADERS[] = { "res/Fxaa_vert.spv", "res/Fxaa_frag.spv" };
+
+// FXAA fragment shader push constants
+struct FxaaParams
+{
+    float rcpFrame[2]; // texel size of the post color target
+    float uvMax[2];    // the target may be larger than the swapchain - don't sample past the rendered area
+};
+
+static bool sameAttachments(const vk::AttachmentFormats &a, const vk::AttachmentFormats &b)
 {
-    VkSampleCountFlags counts = std::min(deviceProperties.limits.framebufferColorSampleCounts, deviceProperties.limits.framebufferDepthSampleCounts);
-    if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
-    if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
-    if (counts & VK_SAMPLE_COUNT_16_BIT) { return VK_SAMPLE_COUNT_16_BIT; }
-    if (counts & VK_SAMPLE_COUNT_8_BIT) { return VK_SAMPLE_COUNT_8_BIT; }
-    if (counts & VK_SAMPLE_COUNT_4_BIT) { return VK_SAMPLE_COUNT_4_BIT; }
-    if (counts & VK_SAMPLE_COUNT_2_BIT) { return VK_SAMPLE_COUNT_2_BIT; }
-    return VK_SAMPLE_COUNT_1_BIT;
+    return a.colorFormat == b.colorFormat && a.depthFormat == b.depthFormat && a.sampleCount == b.sampleCount;
+}
+
+// the manifest outlives GPU and driver changes - only states this device can render to are worth warming up
+static bool attachmentsSupported(const vk::Device &device, const vk::AttachmentFormats &attachments)
+{
+    VkSampleCountFlags counts = device.properties.limits.framebufferColorSampleCounts & device.properties.limits.framebufferDepthSampleCounts;
+    VkSampleCountFlags sampleCount = attachments.sampleCount;
+    if (sampleCount == 0 || (sampleCount & (sampleCount - 1)) != 0 || !(counts & sampleCount))
+        return false;
+
+    VkFormatProperties colorProps, depthProps;
+    vkGetPhysicalDeviceFormatProperties(device.physical, attachments.colorFormat, &colorProps);
+    vkGetPhysicalDeviceFormatProperties(device.physical, attachments.depthFormat, &depthProps);
+
+    return (colorProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) &&
+           (depthProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+// cycled through by NextPresentMode() - lowest power (vsync) first, lowest latency (tearing) last
+static const VkPresentModeKHR PRESENT_MODES[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+static VkSampleCountFlagBits aaSampleCount(RenderContext::AAMode mode)
+{
+    switch (mode)
+    {
+    case RenderContext::AA_MSAA_2X: return VK_SAMPLE_COUNT_2_BIT;
+    case RenderContext::AA_MSAA_4X: return VK_SAMPLE_COUNT_4_BIT;
+    case RenderContext::AA_MSAA_8X: return VK_SAMPLE_COUNT_8_BIT;
+    default: return VK_SAMPLE_COUNT_1_BIT;
+    }
 }
 
 // initialize Vulkan render context
-bool RenderContext::Init(const char *title, int x, int y, int w, int h)
+bool RenderContext::Init(const char *title, int x, int y, int w, int h, int framesInFlight)
 {
+    m_framesInFlight = std::max(1, std::min(framesInFlight, MAX_FRAMES_IN_FLIGHT));
+    m_maxQueuedFrames = m_framesInFlight;
+
     window = SDL_CreateWindow(title, x, y, w, h, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
     SDL_GetWindowSize(window, &width, &height);
 
@@ -50,32 +88,37 @@ void RenderContext::Destroy()
 {
     if (window)
     {
+        // workers may still be creating pipelines
+        vk::stopPipelineCompiler(device, m_pipelineCompiler);
+        RetireReplacedPipelines();
         vkDeviceWaitIdle(device.logical);
 
-        vk::destroyRenderPass(device, m_renderPass);
-        vk::destroyRenderPass(device, m_msaaRenderPass);
-        vk::freeCommandBuffers(device, device.commandPool, m_commandBuffers);
+        for (vk::RenderPass &rp : m_renderPasses)
+            vk::destroyRenderPass(device, rp);
+        vk::destroyRenderPass(device, m_postRenderPass);
+        if (m_timestampPool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(device.logical, m_timestampPool, nullptr);
+        vk::destroyFrameContexts(device, m_transientBuffer, m_frames);
         vkDestroyCommandPool(device.logical, device.commandPool, nullptr);
         vkDestroyCommandPool(device.logical, device.transferCommandPool, nullptr);
  
         DestroyFramebuffers();
         DestroyImageViews();
         DestroyDrawBuffers();
+        DeferDestroy(m_fxaaPipeline);
+        DeferDestroy(m_fxaaDescriptor);
+        // device is idle - release everything still pending
+        vk::flushDeletionQueue(device, m_deletionQueue, UINT64_MAX);
+        vk::destroyTimeline(device, m_frameTimeline);
 
         TextureManager::GetInstance()->ReleaseTextures();
 
         vkDestroySwapchainKHR(device.logical, swapChain.sc, nullptr);
 
-        for (int i = 0; i < NUM_CMDBUFFERS; ++i)
-        {
-            vkDestroySemaphore(device.logical, m_imageAvailableSemaphores[i], nullptr);
-            vkDestroySemaphore(device.logical, m_renderFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device.logical, m_fences[i], nullptr);
-        }
-
         vk::destroyAllocator(device.allocator);
-        vkDestroyPipelineCache(device.logical, pipelineCache, nullptr);
-        vkDestroyDevice(device.logical, nullptr);
+        SavePipelineCache();
+        vk::destroyPipelineCache(device, pipelineCache);
+        vk::destroyDevice(device);
         vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 #ifdef VALIDATION_LAYERS_ON
         vk::destroyValidationLayers(m_instance);
@@ -86,11 +129,24 @@ void RenderContext::Destroy()
     }
 }
 
-VkResult RenderContext::RenderStart()
+VkResult RenderContext::RenderStart(vk::FrameContext **frameContext)
 {
-    VkResult result = vkAcquireNextImageKHR(device.logical, swapChain.sc, UINT64_MAX, m_imageAvailableSemaphores[s_currentCmdBuffer], VK_NULL_HANDLE, &m_imageIndex);
-    activeCmdBuffer = m_commandBuffers[s_currentCmdBuffer];
- 
+    vk::FrameContext &frame = m_frames[m_currentFrame];
+    activeFrame = &frame;
+    activeCmdBuffer = frame.cmdBuffer;
+
+    // wait until the GPU is done with this frame's command buffer, semaphores and transient memory
+    WaitForFrame(frame.submitValue);
+    vk::flushDeletionQueue(device, m_deletionQueue, CompletedFrameValue());
+    vk::updatePipelineCompiler(device, m_pipelineCompiler);
+    RetireReplacedPipelines();
+
+    // any number of rebuild requests since the last frame result in a single rebuild
+    if (m_swapChainDirty && !RecreateSwapChain())
+        return VK_ERROR_OUT_OF_DATE_KHR;
+
+    VkResult result = vkAcquireNextImageKHR(device.logical, swapChain.sc, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &m_imageIndex);
+
     // swapchain has become incompatible - need to recreate it
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
@@ -99,58 +155,112 @@ VkResult RenderContext::RenderStart()
         return result;
     }
 
-    VK_VERIFY(vkWaitForFences(device.logical, 1, &m_fences[s_currentCmdBuffer], VK_TRUE, UINT64_MAX));
-    vkResetFences(device.logical, 1, &m_fences[s_currentCmdBuffer]);
-
     LOG_MESSAGE_ASSERT(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Could not acquire swapchain image: " << result);
 
+    // the image may still be rendered to by an older frame if the swapchain has fewer images than frames in flight
+    WaitForFrame(m_imageSubmitValues[m_imageIndex]);
+
+    if (!device.timelineSemaphores)
+        vkResetFences(device.logical, 1, &frame.fence);
+    frame.transient.used = 0;
+    m_lateLatches.clear();
+
+    if (frameContext)
+        *frameContext = &frame;
+
     // setup command buffers and render pass for drawing
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     beginInfo.pInheritanceInfo = nullptr;
 
-    result = vkBeginCommandBuffer(m_commandBuffers[s_currentCmdBuffer], &beginInfo);
+    result = vkBeginCommandBuffer(frame.cmdBuffer, &beginInfo);
     LOG_MESSAGE_ASSERT(result == VK_SUCCESS, "Could not begin command buffer: " << result);
 
-    VkClearValue clearColors[2];
-    clearColors[0].color = { 0.f, 0.f, 0.f, 1.f };
-    clearColors[1].depthStencil = { 1.0f, 0 };
-    VkRenderPassBeginInfo renderBeginInfo = {};
-    renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderBeginInfo.renderPass = activeRenderPass.renderPass;
-    renderBeginInfo.framebuffer = (activeRenderPass.sampleCount == VK_SAMPLE_COUNT_1_BIT) ? m_frameBuffers[m_imageIndex] : m_msaaFrameBuffers[m_imageIndex];
-    renderBeginInfo.renderArea.offset = { 0, 0 };
-    renderBeginInfo.renderArea.extent = swapChain.extent;
-    renderBeginInfo.clearValueCount = 2;
-    renderBeginInfo.pClearValues = clearColors;
-
-    vkCmdBeginRenderPass(m_commandBuffers[s_currentCmdBuffer], &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdSetViewport(m_commandBuffers[s_currentCmdBuffer], 0, 1, &m_viewport);
-    vkCmdSetScissor(m_commandBuffers[s_currentCmdBuffer], 0, 1, &m_scissor);
+    if (m_timestampPool != VK_NULL_HANDLE)
+    {
+        ReadGpuTimestamps(frame);
+        vkCmdResetQueryPool(frame.cmdBuffer, m_timestampPool, m_currentFrame * 2, 2);
+        vkCmdWriteTimestamp(frame.cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, m_currentFrame * 2);
+    }
+
+    // barriers in front of the scene pass, which is recorded by the caller
+    vk::setImportedImage(m_renderGraph, m_swapChainTarget, swapChain.images[m_imageIndex], m_imageViews[m_imageIndex], swapChain.format);
+    vk::executeRenderGraph(m_renderGraph, frame.cmdBuffer);
+
+    BeginPass(frame.cmdBuffer, false);
+    vkCmdSetViewport(frame.cmdBuffer, 0, 1, &m_viewport);
+    vkCmdSetScissor(frame.cmdBuffer, 0, 1, &m_scissor);
 
     return VK_SUCCESS;
 }
 
 VkResult RenderContext::Submit()
 {
-    vkCmdEndRenderPass(m_commandBuffers[s_currentCmdBuffer]);
+    vk::FrameContext &frame = m_frames[m_currentFrame];
+    EndPass(frame.cmdBuffer, false);
 
-    VkResult result = vkEndCommandBuffer(m_commandBuffers[s_currentCmdBuffer]);
+    // remaining passes (post-processing) and the transition for presentation
+    vk::executeRenderGraph(m_renderGraph, frame.cmdBuffer);
+
+    if (m_timestampPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(frame.cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, m_currentFrame * 2 + 1);
+
+    VkResult result = vkEndCommandBuffer(frame.cmdBuffer);
     LOG_MESSAGE_ASSERT(result == VK_SUCCESS, "Error recording command buffer: " << result);
 
+    // last moment to change what the GPU will see: the commands only reference these matrices, the writes are flushed below
+    if (lateLatching && !m_lateLatches.empty())
+    {
+        if (lateLatchUpdate)
+            lateLatchUpdate();
+
+        for (Math::Matrix4f *matrix : m_lateLatches)
+            *matrix = ModelViewProjectionMatrix;
+    }
+    m_lateLatches.clear();
+
+    uint64_t submitValue = m_frameTimeline.value + 1;
+
+    // presentation still needs the binary semaphore, the timeline value is signaled alongside it
+    VkSemaphore signalSemaphores[] = { frame.renderFinished, m_frameTimeline.semaphore };
+    uint64_t signalValues[] = { 0, submitValue };
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = device.timelineSemaphores ? &timelineInfo : nullptr;
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &m_imageAvailableSemaphores[s_currentCmdBuffer];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &m_renderFinishedSemaphores[s_currentCmdBuffer];
+    submitInfo.pWaitSemaphores = &frame.imageAvailable;
+    submitInfo.signalSemaphoreCount = device.timelineSemaphores ? 2 : 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[s_currentCmdBuffer];
+    submitInfo.pCommandBuffers = &frame.cmdBuffer;
 
-    return vkQueueSubmit(device.graphicsQueue, 1, &submitInfo, m_fences[s_currentCmdBuffer]);
+    // no-op on coherent memory
+    if (frame.transient.used > 0)
+        vmaFlushAllocation(device.allocator, m_transientBuffer.allocation, frame.transient.baseOffset, frame.transient.used);
+
+    result = vkQueueSubmit(device.graphicsQueue, 1, &submitInfo, frame.fence);
+
+    if (result == VK_SUCCESS)
+    {
+        if (m_inputTime != 0)
+            m_inputTimes.push_back(std::make_pair(submitValue, m_inputTime));
+        m_inputTime = 0;
+        m_frameTimeline.value = submitValue;
+        frame.submitValue = submitValue;
+        m_imageSubmitValues[m_imageIndex] = submitValue;
+        frame.timestampsWritten = m_timestampPool != VK_NULL_HANDLE;
+    }
+
+    return result;
 }
 
 VkResult RenderContext::Present()
@@ -159,7 +269,7 @@ VkResult RenderContext::Present()
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &m_renderFinishedSemaphores[s_currentCmdBuffer];
+    presentInfo.pWaitSemaphores = &m_frames[m_currentFrame].renderFinished;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &m_imageIndex;
@@ -167,14 +277,19 @@ VkResult RenderContext::Present()
 
     VkResult renderResult = vkQueuePresentKHR(device.presentQueue, &presentInfo);
 
-    // recreate swapchain if it's out of date
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (m_lastPresentTime != 0)
+        m_presentInterval = float(double(now - m_lastPresentTime) * 1000.0 / double(SDL_GetPerformanceFrequency()));
+    m_lastPresentTime = now;
+
+    // recreate swapchain before the next frame if it's out of date
     if (renderResult == VK_ERROR_OUT_OF_DATE_KHR || renderResult == VK_SUBOPTIMAL_KHR)
     {
         LOG_MESSAGE("SwapChain out of date/suboptimal after vkQueuePresentKHR - rebuilding!");
-        RecreateSwapChain();
+        RequestSwapChainRebuild();
     }
 
-    s_currentCmdBuffer = (s_currentCmdBuffer + 1) % NUM_CMDBUFFERS;
+    m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
 
     return renderResult;
 }
@@ -198,24 +313,196 @@ Math::Vector2f RenderContext::WindowSize()
     return Math::Vector2f((float)surfaceCaps.currentExtent.width, (float)surfaceCaps.currentExtent.height);
 }
 
-VkSampleCountFlagBits RenderContext::ToggleMSAA()
+bool RenderContext::SetAAMode(AAMode mode)
+{
+    if (!AAModeSupported(mode))
+        return false;
+
+    if (mode == m_aaMode)
+        return true;
+
+    if (mode == AA_FXAA)
+        CreatePostProcess();
+
+    // "flip" render passes on mode change - frames in flight keep the old one, pipelines built for it are deferred for deletion
+    SelectAttachments(mode);
+    m_aaMode = mode;
+
+    // only the attachments of the active render pass exist, so switch them along with it
+    DestroyFramebuffers();
+    CreateDrawBuffers();
+    m_frameBuffers = CreateFramebuffers(m_activeRenderPass);
+    if (m_aaMode == AA_FXAA)
+        m_postFrameBuffers = CreateFramebuffers(m_postRenderPass);
+
+    return true;
+}
+
+RenderContext::AAMode RenderContext::NextAAMode()
+{
+    // AA_NONE is always supported, so this terminates
+    AAMode mode = m_aaMode;
+    do
+    {
+        mode = (AAMode)((mode + 1) % AA_MODE_COUNT);
+    } while (!AAModeSupported(mode));
+
+    SetAAMode(mode);
+    return m_aaMode;
+}
+
+bool RenderContext::AAModeSupported(AAMode mode) const
+{
+    if (mode == AA_FXAA)
+    {
+        // the scene is sampled from an image in swapchain format
+        VkFormatProperties formatProps;
+        vkGetPhysicalDeviceFormatProperties(device.physical, swapChain.format, &formatProps);
+        if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+            return false;
+
+        // shaders are optional data - the mode is simply unavailable if they haven't been compiled
+        for (const char *shader : FXAA_SHADERS)
+        {
+            if (!std::ifstream(shader, std::ios::binary).is_open())
+                return false;
+        }
+
+        return true;
+    }
+
+    if (mode < AA_NONE || mode >= AA_MODE_COUNT)
+        return false;
+
+    VkSampleCountFlags counts = device.properties.limits.framebufferColorSampleCounts & device.properties.limits.framebufferDepthSampleCounts;
+    return (counts & aaSampleCount(mode)) != 0;
+}
+
+const char *RenderContext::AAModeName(AAMode mode)
+{
+    switch (mode)
+    {
+    case AA_NONE:    return "off";
+    case AA_MSAA_2X: return "MSAA x2";
+    case AA_MSAA_4X: return "MSAA x4";
+    case AA_MSAA_8X: return "MSAA x8";
+    case AA_FXAA:    return "FXAA";
+    default:         return "unknown";
+    }
+}
+
+bool RenderContext::SetPresentMode(VkPresentModeKHR mode)
+{
+    if (!PresentModeSupported(mode))
+        return false;
+
+    if (mode != swapChain.presentMode)
+    {
+        swapChain.presentMode = mode;
+        RequestSwapChainRebuild();
+    }
+
+    return true;
+}
+
+VkPresentModeKHR RenderContext::NextPresentMode()
+{
+    int count = sizeof(PRESENT_MODES) / sizeof(PRESENT_MODES[0]);
+    int current = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (PRESENT_MODES[i] == swapChain.presentMode)
+            current = i;
+    }
+
+    // FIFO is always supported, so this terminates
+    for (int i = 1; i <= count; ++i)
+    {
+        if (SetPresentMode(PRESENT_MODES[(current + i) % count]))
+            break;
+    }
+
+    return swapChain.presentMode;
+}
+
+bool RenderContext::PresentModeSupported(VkPresentModeKHR mode) const
+{
+    uint32_t modeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physical, m_surface, &modeCount, nullptr);
+    std::vector<VkPresentModeKHR> modes(modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physical, m_surface, &modeCount, modes.data());
+
+    return std::find(modes.begin(), modes.end(), mode) != modes.end();
+}
+
+const char *RenderContext::PresentModeName(VkPresentModeKHR mode)
+{
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO relaxed";
+    case VK_PRESENT_MODE_MAILBOX_KHR:      return "mailbox";
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "immediate";
+    default:                               return "unknown";
+    }
+}
+
+void RenderContext::SetSwapChainImageCount(uint32_t count)
+{
+    if (count == swapChain.requestedImageCount)
+        return;
+
+    swapChain.requestedImageCount = count;
+    RequestSwapChainRebuild();
+}
+
+void RenderContext::SetMaxQueuedFrames(int count)
+{
+    m_maxQueuedFrames = std::max(1, std::min(count, m_framesInFlight));
+}
+
+void RenderContext::WaitForFrameLatency()
+{
+    // RenderStart() only waits for the frame that last used the same frame context - limit the queue further if requested
+    if (m_frameTimeline.value >= (uint64_t)m_maxQueuedFrames)
+        WaitForFrame(m_frameTimeline.value - m_maxQueuedFrames + 1);
+
+    UpdateInputLatency();
+    m_inputTime = SDL_GetPerformanceCounter();
+}
+
+void RenderContext::LateLatchMatrix(Math::Matrix4f *transientMatrix)
+{
+    m_lateLatches.push_back(transientMatrix);
+}
+
+void RenderContext::UpdateInputLatency()
 {
-    // "flip" render passes on MSAA toggle
-    vkDeviceWaitIdle(device.logical);
-    activeRenderPass = (activeRenderPass.renderPass == m_msaaRenderPass.renderPass) ? m_renderPass : m_msaaRenderPass;
+    uint64_t completedValue = CompletedFrameValue();
+    Uint64 now = SDL_GetPerformanceCounter();
 
-    return activeRenderPass.sampleCount;
+    while (!m_inputTimes.empty() && m_inputTimes.front().first <= completedValue)
+    {
+        // estimate: input sampling until the frame is seen finished (accurate to a frame), plus up to one present interval to reach the screen
+        double sinceInput = double(now - m_inputTimes.front().second) * 1000.0 / double(SDL_GetPerformanceFrequency());
+        m_inputLatency = float(sinceInput) + std::max(m_presentInterval, 0.f);
+        m_inputTimes.pop_front();
+    }
 }
 
 bool RenderContext::RecreateSwapChain()
 {
-    vkDeviceWaitIdle(device.logical);
+    m_swapChainDirty = false;
+
+    // no device wait - frames in flight finish presenting to the retired swapchain, which goes to the deletion queue with everything else
     DestroyFramebuffers();
     DestroyImageViews();
 
     // set initial swap chain extent to current window size - in case WM can't determine it by itself
     swapChain.extent = { (uint32_t)width, (uint32_t)height };
-    VK_VERIFY(vk::createSwapChain(device, m_surface, &swapChain, swapChain.sc));
+    VkSwapchainKHR oldSwapchain = swapChain.sc;
+    VK_VERIFY(vk::createSwapChain(device, m_surface, &swapChain, oldSwapchain));
+    DeferDestroy(vk::DeletionQueue::SWAPCHAIN, (uint64_t)oldSwapchain);
 
     m_viewport.width  = (float)swapChain.extent.width;
     m_viewport.height = (float)swapChain.extent.height;
@@ -230,11 +517,13 @@ bool RenderContext::RecreateSwapChain()
     left = -scrRatio;
     right = scrRatio;
 
-    DestroyDrawBuffers();
     CreateDrawBuffers();
     if (!CreateImageViews()) return false;
-    m_frameBuffers = CreateFramebuffers(m_renderPass);
-    m_msaaFrameBuffers = CreateFramebuffers(m_msaaRenderPass);
+    m_frameBuffers = CreateFramebuffers(m_activeRenderPass);
+    if (m_aaMode == AA_FXAA)
+        m_postFrameBuffers = CreateFramebuffers(m_postRenderPass);
+    // images of the new swapchain haven't been rendered to yet
+    m_imageSubmitValues.assign(swapChain.images.size(), 0);
 
     return true;
 }
@@ -246,13 +535,12 @@ bool RenderContext::InitVulkan(const char *appTitle)
     //VK_VERIFY(vk::createSurface(window, m_instance, &m_surface));
     SDL_Vulkan_CreateSurface(window, m_instance, &m_surface);
 
-    device = vk::createDevice(m_instance, m_surface);
+    device = vk::createDevice(m_instance, m_surface, allowTimelineSemaphores, allowDynamicRendering, allowImagelessFramebuffer, allowPipelineLibrary, allowDynamicState);
     VK_VERIFY(vk::createAllocator(device, &device.allocator));
     // set initial swap chain extent to current window size - in case WM can't determine it by itself
     swapChain.extent = { (uint32_t)width, (uint32_t)height };
-    // desired present mode
-    swapChain.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 
+    // present mode and image count preferences may have been set before Init() - the best available mode is used otherwise
     VK_VERIFY(vk::createSwapChain(device, m_surface, &swapChain, VK_NULL_HANDLE));
 
     m_viewport.x = 0.f;
@@ -266,52 +554,119 @@ bool RenderContext::InitVulkan(const char *appTitle)
     m_scissor.offset.y = 0;
     m_scissor.extent = swapChain.extent;
 
-    CreateFences();
-    CreateSemaphores();
     CreatePipelineCache();
+    vk::startPipelineCompiler(device, m_pipelineCompiler);
 
-    m_msaaRenderPass.sampleCount = getMaxUsableSampleCount(device.properties);
-
-    VK_VERIFY(vk::createRenderPass(device, swapChain, &m_renderPass));
-    VK_VERIFY(vk::createRenderPass(device, swapChain, &m_msaaRenderPass));
     VK_VERIFY(vk::createCommandPool(device, device.graphicsFamilyIndex, &device.commandPool));
     VK_VERIFY(vk::createCommandPool(device, device.transferFamilyIndex, &device.transferCommandPool));
+    SelectAttachments(m_aaMode);
     CreateDrawBuffers();
     if (!CreateImageViews()) return false;
-    m_frameBuffers = CreateFramebuffers(m_renderPass);
-    m_msaaFrameBuffers = CreateFramebuffers(m_msaaRenderPass);
-	activeRenderPass = m_renderPass;
+    m_frameBuffers = CreateFramebuffers(m_activeRenderPass);
+    m_imageSubmitValues.assign(swapChain.images.size(), 0);
+
+    // keep each frame's slice of transient memory aligned for dynamic uniform buffer offsets
+    VkDeviceSize uboAlignment = device.properties.limits.minUniformBufferOffsetAlignment;
+    VkDeviceSize transientSize = (TRANSIENT_MEMORY_SIZE + uboAlignment - 1) / uboAlignment * uboAlignment;
+    VK_VERIFY(vk::createFrameContexts(device, m_framesInFlight, transientSize, &m_transientBuffer, m_frames));
+
+    if (device.timelineSemaphores)
+        VK_VERIFY(vk::createTimeline(device, &m_frameTimeline));
+
+    // two timestamps per frame in flight bracket all of the frame's GPU work
+    if (device.properties.limits.timestampComputeAndGraphics)
+    {
+        VkQueryPoolCreateInfo qpCreateInfo = {};
+        qpCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        qpCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        qpCreateInfo.queryCount = (uint32_t)m_framesInFlight * 2;
 
-    // allocate NUM_CMDBUFFERS command buffers (used to be m_frameBuffers.size())
-    VK_VERIFY(vk::createCommandBuffers(device, device.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_commandBuffers, NUM_CMDBUFFERS));
+        VK_VERIFY(vkCreateQueryPool(device.logical, &qpCreateInfo, nullptr, &m_timestampPool));
+    }
 
     return true;
 }
 
 void RenderContext::CreateDrawBuffers()
 {
-    // standard depth buffer
-    m_depthBuffer = vk::createDepthBuffer(device, swapChain, m_renderPass.sampleCount);
-    // additional render targets for MSAA
-    m_msaaDepthBuffer = vk::createDepthBuffer(device, swapChain, m_msaaRenderPass.sampleCount);
-    m_msaaColor = vk::createColorBuffer(device, swapChain, m_msaaRenderPass.sampleCount);
+    // attachments only need to be at least as large as the framebuffer - keep them unless the swapchain outgrew them or shrank well below
+    const VkExtent2D &extent = swapChain.extent;
+    bool fits = extent.width <= m_drawBufferExtent.width && extent.height <= m_drawBufferExtent.height;
+    bool oversized = extent.width * 2 < m_drawBufferExtent.width || extent.height * 2 < m_drawBufferExtent.height;
+
+    if (m_depthBuffer.image != VK_NULL_HANDLE && m_drawBufferMode == m_aaMode && fits && !oversized)
+        return;
+
+    DestroyDrawBuffers();
+
+    uint32_t maxDimension = device.properties.limits.maxImageDimension2D;
+    m_drawBufferExtent.width  = std::min(maxDimension, (extent.width  + DRAW_BUFFER_GRANULARITY - 1) / DRAW_BUFFER_GRANULARITY * DRAW_BUFFER_GRANULARITY);
+    m_drawBufferExtent.height = std::min(maxDimension, (extent.height + DRAW_BUFFER_GRANULARITY - 1) / DRAW_BUFFER_GRANULARITY * DRAW_BUFFER_GRANULARITY);
+
+    BuildRenderGraph();
+
+    if (m_aaMode == AA_FXAA)
+        UpdatePostDescriptor();
+
+    m_drawBufferMode = m_aaMode;
+}
+
+void RenderContext::BuildRenderGraph()
+{
+    VkSampleCountFlagBits sampleCount = activeAttachments.sampleCount;
+    bool msaa = sampleCount != VK_SAMPLE_COUNT_1_BIT;
+    bool fxaa = m_aaMode == AA_FXAA;
+    // render passes leave their attachments in the final layouts of their descriptions, dynamic rendering leaves transitions to the graph
+    bool renderPass = !device.dynamicRendering;
+    VkImageLayout presented = renderPass ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+
+    m_swapChainTarget = vk::addImportedImage(m_renderGraph, "swapchain", VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    uint32_t depth = vk::addTransientImage(m_renderGraph, "depth", activeAttachments.depthFormat, m_drawBufferExtent, sampleCount);
+    uint32_t sceneColor = m_swapChainTarget;
+    VkImageLayout sceneColorAfter = presented;
+
+    // multisampled color is resolved to the swapchain image, FXAA renders the scene offscreen
+    if (msaa)
+    {
+        sceneColor = vk::addTransientImage(m_renderGraph, "msaa color", swapChain.format, m_drawBufferExtent, sampleCount);
+        sceneColorAfter = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    else if (fxaa)
+    {
+        sceneColor = vk::addTransientImage(m_renderGraph, "scene color", swapChain.format, m_drawBufferExtent);
+        sceneColorAfter = renderPass ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    // recorded by the application between RenderStart() and Submit()
+    uint32_t scene = vk::addPass(m_renderGraph, "scene");
+    vk::addAccess(m_renderGraph, scene, sceneColor, vk::RenderGraph::COLOR_ATTACHMENT, sceneColorAfter);
+    vk::addAccess(m_renderGraph, scene, depth, vk::RenderGraph::DEPTH_ATTACHMENT);
+    if (msaa)
+        vk::addAccess(m_renderGraph, scene, m_swapChainTarget, vk::RenderGraph::COLOR_ATTACHMENT, presented);
+
+    if (fxaa)
+    {
+        uint32_t post = vk::addPass(m_renderGraph, "fxaa", [this](VkCommandBuffer cmdBuffer) { RecordPostProcess(cmdBuffer); });
+        vk::addAccess(m_renderGraph, post, sceneColor, vk::RenderGraph::SAMPLED);
+        vk::addAccess(m_renderGraph, post, m_swapChainTarget, vk::RenderGraph::COLOR_ATTACHMENT, presented);
+    }
+
+    VK_VERIFY(vk::compileRenderGraph(device, m_renderGraph));
+
+    m_depthBuffer = m_renderGraph.resources[depth].texture;
+    if (msaa)
+        m_msaaColor = m_renderGraph.resources[sceneColor].texture;
+    if (fxaa)
+        m_postColor = m_renderGraph.resources[sceneColor].texture;
 }
 
 void RenderContext::DestroyDrawBuffers()
 {
-    auto destroyDrawBuffer = [](vk::Device &device, vk::Texture &drawBuffer) {
-        if (drawBuffer.image != VK_NULL_HANDLE)
-        {
-            vmaDestroyImage(device.allocator, drawBuffer.image, drawBuffer.allocation);
-            vkDestroyImageView(device.logical, drawBuffer.imageView, nullptr);
-            drawBuffer.image = VK_NULL_HANDLE;
-            drawBuffer.imageView = VK_NULL_HANDLE;
-        }
-    };
-
-    destroyDrawBuffer(device, m_depthBuffer);
-    destroyDrawBuffer(device, m_msaaDepthBuffer);
-    destroyDrawBuffer(device, m_msaaColor);
+    DeferDestroy(m_renderGraph);
+    m_depthBuffer = vk::Texture();
+    m_msaaColor = vk::Texture();
+    m_postColor = vk::Texture();
+    m_drawBufferExtent = { 0, 0 };
 }
 
 bool RenderContext::CreateImageViews()
@@ -336,27 +691,69 @@ bool RenderContext::CreateImageViews()
 void RenderContext::DestroyImageViews()
 {
     for (VkImageView &iv : m_imageViews)
-        vkDestroyImageView(device.logical, iv, nullptr);
+        DeferDestroy(vk::DeletionQueue::IMAGE_VIEW, (uint64_t)iv);
+
+    m_imageViews.clear();
 }
 
 std::vector<VkFramebuffer> RenderContext::CreateFramebuffers(const vk::RenderPass &rp)
 {
-    std::vector<VkFramebuffer> frameBuffers(m_imageViews.size());
+    std::vector<VkFramebuffer> frameBuffers;
+
+    // attachments are bound when rendering begins
+    if (device.dynamicRendering)
+        return frameBuffers;
+
+    // imageless framebuffers only describe their attachments, so a single one serves every swapchain image
+    frameBuffers.resize(device.imagelessFramebuffer ? 1 : m_imageViews.size());
 
     VkFramebufferCreateInfo fbCreateInfo = {};
     fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     fbCreateInfo.renderPass = rp.renderPass;
-    fbCreateInfo.attachmentCount = (rp.sampleCount != VK_SAMPLE_COUNT_1_BIT) ? 3 : 2;
     fbCreateInfo.width  = swapChain.extent.width;
     fbCreateInfo.height = swapChain.extent.height;
     fbCreateInfo.layers = 1;
 
+    bool postPass = rp.renderPass == m_postRenderPass.renderPass;
+
     for (size_t i = 0; i < frameBuffers.size(); ++i)
     {
-        VkImageView attachments[] = { m_imageViews[i], m_depthBuffer.imageView };
-        VkImageView attachmentsMSAA[] = { m_msaaColor.imageView, m_msaaDepthBuffer.imageView, m_imageViews[i] };
+        PassAttachment attachments[3];
+        VkImageView views[3];
+        VkFramebufferAttachmentImageInfoKHR imageInfos[3];
+        uint32_t attachmentCount = PassAttachments(postPass, (uint32_t)i, attachments);
+
+        for (uint32_t j = 0; j < attachmentCount; ++j)
+        {
+            views[j] = attachments[j].view;
+
+            // has to match the parameters the image was created with
+            imageInfos[j] = {};
+            imageInfos[j].sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO_KHR;
+            imageInfos[j].usage = attachments[j].usage;
+            imageInfos[j].width = attachments[j].extent.width;
+            imageInfos[j].height = attachments[j].extent.height;
+            imageInfos[j].layerCount = 1;
+            imageInfos[j].viewFormatCount = 1;
+            imageInfos[j].pViewFormats = &attachments[j].format;
+        }
+
+        VkFramebufferAttachmentsCreateInfoKHR fbAttachmentsInfo = {};
+        fbAttachmentsInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO_KHR;
+        fbAttachmentsInfo.attachmentImageInfoCount = attachmentCount;
+        fbAttachmentsInfo.pAttachmentImageInfos = imageInfos;
+
+        fbCreateInfo.attachmentCount = attachmentCount;
+        if (device.imagelessFramebuffer)
+        {
+            fbCreateInfo.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT_KHR;
+            fbCreateInfo.pNext = &fbAttachmentsInfo;
+        }
+        else
+        {
+            fbCreateInfo.pAttachments = views;
+        }
 
-        fbCreateInfo.pAttachments = (rp.sampleCount != VK_SAMPLE_COUNT_1_BIT) ? attachmentsMSAA : attachments;
         VkResult result = vkCreateFramebuffer(device.logical, &fbCreateInfo, nullptr, &frameBuffers[i]);
 
         if (result != VK_SUCCESS)
@@ -372,44 +769,405 @@ std::vector<VkFramebuffer> RenderContext::CreateFramebuffers(const vk::RenderPas
 
 void RenderContext::DestroyFramebuffers()
 {
-    for (size_t i = 0; i < m_imageViews.size(); ++i)
+    for (VkFramebuffer &fb : m_frameBuffers)
+        DeferDestroy(vk::DeletionQueue::FRAMEBUFFER, (uint64_t)fb);
+    for (VkFramebuffer &fb : m_postFrameBuffers)
+        DeferDestroy(vk::DeletionQueue::FRAMEBUFFER, (uint64_t)fb);
+
+    m_frameBuffers.clear();
+    m_postFrameBuffers.clear();
+}
+
+const vk::RenderPass &RenderContext::AARenderPass(AAMode mode)
+{
+    vk::RenderPass &rp = m_renderPasses[mode];
+
+    if (rp.renderPass == VK_NULL_HANDLE)
     {
-        vkDestroyFramebuffer(device.logical, m_frameBuffers[i], nullptr);
-        vkDestroyFramebuffer(device.logical, m_msaaFrameBuffers[i], nullptr);
+        rp.sampleCount = aaSampleCount(mode);
+        rp.offscreen = mode == AA_FXAA;
+        VK_VERIFY(vk::createRenderPass(device, swapChain, &rp));
     }
 
-    m_frameBuffers.clear();
-    m_msaaFrameBuffers.clear();
+    return rp;
+}
+
+void RenderContext::SelectAttachments(AAMode mode)
+{
+    activeAttachments.colorFormat = swapChain.format;
+    activeAttachments.depthFormat = vk::getBestDepthFormat(device);
+    activeAttachments.sampleCount = aaSampleCount(mode);
+
+    if (!device.dynamicRendering)
+        m_activeRenderPass = AARenderPass(mode);
+}
+
+uint32_t RenderContext::PassAttachments(bool postPass, uint32_t imageIndex, PassAttachment *attachments) const
+{
+    PassAttachment swapChainImage = { m_imageViews[imageIndex], swapChain.format, swapChain.imageUsage, swapChain.extent };
+    auto drawBuffer = [](const vk::Texture &t) { return PassAttachment{ t.imageView, t.format, t.usage, t.extent }; };
+
+    if (postPass)
+    {
+        attachments[0] = swapChainImage;
+        return 1;
+    }
+
+    if (m_aaMode == AA_FXAA)
+    {
+        attachments[0] = drawBuffer(m_postColor);
+        attachments[1] = drawBuffer(m_depthBuffer);
+        return 2;
+    }
+
+    if (activeAttachments.sampleCount != VK_SAMPLE_COUNT_1_BIT)
+    {
+        attachments[0] = drawBuffer(m_msaaColor);
+        attachments[1] = drawBuffer(m_depthBuffer);
+        attachments[2] = swapChainImage;
+        return 3;
+    }
+
+    attachments[0] = swapChainImage;
+    attachments[1] = drawBuffer(m_depthBuffer);
+    return 2;
+}
+
+void RenderContext::BeginPass(VkCommandBuffer cmdBuffer, bool postPass)
+{
+    PassAttachment attachments[3];
+    uint32_t attachmentCount = PassAttachments(postPass, m_imageIndex, attachments);
+
+    VkClearValue clearColors[2];
+    clearColors[0].color = { 0.f, 0.f, 0.f, 1.f };
+    clearColors[1].depthStencil = { 1.0f, 0 };
+
+    if (!device.dynamicRendering)
+    {
+        VkImageView views[3];
+        for (uint32_t i = 0; i < attachmentCount; ++i)
+            views[i] = attachments[i].view;
+
+        VkRenderPassAttachmentBeginInfoKHR attachmentBeginInfo = {};
+        attachmentBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO_KHR;
+        attachmentBeginInfo.attachmentCount = attachmentCount;
+        attachmentBeginInfo.pAttachments = views;
+
+        const std::vector<VkFramebuffer> &frameBuffers = postPass ? m_postFrameBuffers : m_frameBuffers;
+
+        VkRenderPassBeginInfo renderBeginInfo = {};
+        renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderBeginInfo.pNext = device.imagelessFramebuffer ? &attachmentBeginInfo : nullptr;
+        renderBeginInfo.renderPass = postPass ? m_postRenderPass.renderPass : m_activeRenderPass.renderPass;
+        renderBeginInfo.framebuffer = frameBuffers[device.imagelessFramebuffer ? 0 : m_imageIndex];
+        renderBeginInfo.renderArea.offset = { 0, 0 };
+        renderBeginInfo.renderArea.extent = swapChain.extent;
+        renderBeginInfo.clearValueCount = postPass ? 0 : 2;
+        renderBeginInfo.pClearValues = clearColors;
+
+        vkCmdBeginRenderPass(cmdBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    // layouts were set up by the render graph
+    bool msaaEnabled = attachmentCount == 3;
+
+    VkRenderingAttachmentInfoKHR colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = attachments[0].view;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    // the post-processing pass overwrites every pixel
+    colorAttachment.loadOp = postPass ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = msaaEnabled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearColors[0];
+    if (msaaEnabled)
+    {
+        colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+        colorAttachment.resolveImageView = attachments[2].view;
+        colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkRenderingAttachmentInfoKHR depthAttachment = {};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = attachments[1].view;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = clearColors[1];
+
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = swapChain.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = postPass ? nullptr : &depthAttachment;
+
+    device.cmdBeginRendering(cmdBuffer, &renderingInfo);
+}
+
+void RenderContext::EndPass(VkCommandBuffer cmdBuffer, bool postPass)
+{
+    if (!device.dynamicRendering)
+    {
+        vkCmdEndRenderPass(cmdBuffer);
+        return;
+    }
+
+    device.cmdEndRendering(cmdBuffer);
+}
+
+void RenderContext::CreatePostProcess()
+{
+    if (m_fxaaPipeline.pipeline != VK_NULL_HANDLE)
+        return;
+
+    if (!device.dynamicRendering)
+        VK_VERIFY(vk::createPostRenderPass(device, swapChain, &m_postRenderPass));
+
+    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+    samplerLayoutBinding.binding = 0;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.pImmutableSamplers = nullptr;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerLayoutBinding;
+
+    VK_VERIFY(vkCreateDescriptorSetLayout(device.logical, &layoutInfo, nullptr, &m_fxaaDescriptor.setLayout));
+
+    // fullscreen triangle generated in the vertex shader
+    m_fxaaPipeline.cullMode = VK_CULL_MODE_NONE;
+    m_fxaaPipeline.depthTestEnable = VK_FALSE;
+    m_fxaaPipeline.pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    m_fxaaPipeline.pushConstantRange.offset = 0;
+    m_fxaaPipeline.pushConstantRange.size = sizeof(FxaaParams);
+    m_fxaaPipeline.pushConstantRangeCount = 1;
+    m_fxaaPipeline.cache = &pipelineCache;
+
+    vk::AttachmentFormats postAttachments;
+    postAttachments.colorFormat = swapChain.format;
+
+    VK_VERIFY(vk::createPipeline(device, swapChain, postAttachments, m_fxaaDescriptor.setLayout, nullptr, &m_fxaaPipeline, FXAA_SHADERS));
+}
+
+void RenderContext::UpdatePostDescriptor()
+{
+    // the set may still be bound by frames in flight, so a new one is allocated rather than updated in place
+    DeferDestroy(vk::DeletionQueue::DESCRIPTOR_POOL, (uint64_t)m_fxaaDescriptor.pool);
+    m_fxaaDescriptor.pool = VK_NULL_HANDLE;
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    VK_VERIFY(vkCreateDescriptorPool(device.logical, &poolInfo, nullptr, &m_fxaaDescriptor.pool));
+    VK_VERIFY(vk::createDescriptorSet(device, &m_fxaaDescriptor));
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = m_postColor.imageView;
+    imageInfo.sampler = m_postColor.sampler;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_fxaaDescriptor.set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device.logical, 1, &descriptorWrite, 0, nullptr);
+}
+
+void RenderContext::RecordPostProcess(VkCommandBuffer cmdBuffer)
+{
+    FxaaParams params;
+    params.rcpFrame[0] = 1.f / m_drawBufferExtent.width;
+    params.rcpFrame[1] = 1.f / m_drawBufferExtent.height;
+    params.uvMax[0] = (swapChain.extent.width  - 0.5f) * params.rcpFrame[0];
+    params.uvMax[1] = (swapChain.extent.height - 0.5f) * params.rcpFrame[1];
+
+    // viewport and scissor set in RenderStart are still current
+    BeginPass(cmdBuffer, true);
+    vk::bindPipeline(device, cmdBuffer, m_fxaaPipeline, VK_SAMPLE_COUNT_1_BIT);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_fxaaPipeline.layout, 0, 1, &m_fxaaDescriptor.set, 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, m_fxaaPipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FxaaParams), &params);
+    vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    EndPass(cmdBuffer, true);
 }
 
-void RenderContext::CreateFences()
+void RenderContext::ReadGpuTimestamps(vk::FrameContext &frame)
 {
-    VkFenceCreateInfo fCreateInfo = {};
-    fCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    if (!frame.timestampsWritten)
+        return;
+
+    // the frame has been waited for, so results are available without stalling
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(device.logical, m_timestampPool, m_currentFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
 
-    for (int i = 0; i < NUM_CMDBUFFERS; ++i)
+    if (result == VK_SUCCESS && timestamps[1] >= timestamps[0])
+        m_gpuFrameTime = float(double(timestamps[1] - timestamps[0]) * device.properties.limits.timestampPeriod / 1000000.0);
+
+    frame.timestampsWritten = false;
+}
+
+void RenderContext::WaitForFrame(uint64_t value)
+{
+    // nothing submitted yet
+    if (value == 0)
+        return;
+
+    if (device.timelineSemaphores)
     {
-        VK_VERIFY(vkCreateFence(device.logical, &fCreateInfo, nullptr, &m_fences[i]));
+        VK_VERIFY(vk::waitTimeline(device, m_frameTimeline, value));
+        return;
+    }
+
+    // binary fallback: wait on the fence of the frame that made the submission - if that frame has submitted again since, it has already waited for it
+    for (const vk::FrameContext &frame : m_frames)
+    {
+        if (frame.submitValue == value)
+            VK_VERIFY(vkWaitForFences(device.logical, 1, &frame.fence, VK_TRUE, UINT64_MAX));
     }
 }
 
-void RenderContext::CreateSemaphores()
+uint64_t RenderContext::CompletedFrameValue()
 {
-    VkSemaphoreCreateInfo sCreateInfo = {};
-    sCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (device.timelineSemaphores)
+        return vk::completedTimelineValue(device, m_frameTimeline);
 
-    for (int i = 0; i < NUM_CMDBUFFERS; ++i)
+    // frames complete in submission order on the graphics queue, so any signaled fence covers all earlier values
+    for (const vk::FrameContext &frame : m_frames)
     {
-        VK_VERIFY(vkCreateSemaphore(device.logical, &sCreateInfo, nullptr, &m_imageAvailableSemaphores[i]));
-        VK_VERIFY(vkCreateSemaphore(device.logical, &sCreateInfo, nullptr, &m_renderFinishedSemaphores[i]));
+        if (frame.submitValue > m_completedFrameValue && vkGetFenceStatus(device.logical, frame.fence) == VK_SUCCESS)
+            m_completedFrameValue = frame.submitValue;
     }
+
+    return m_completedFrameValue;
 }
 
 void RenderContext::CreatePipelineCache()
 {
-    VkPipelineCacheCreateInfo pcInfo = {};
-    pcInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    // per-user writable directory, created by SDL if needed
+    char *prefPath = SDL_GetPrefPath("kondrak", "vk_playground");
+    if (prefPath)
+    {
+        m_pipelineCachePath = std::string(prefPath) + "pipeline_cache.bin";
+        m_pipelineManifestPath = std::string(prefPath) + "pipeline_manifest.txt";
+        SDL_free(prefPath);
+    }
+
+    VK_VERIFY(vk::createPipelineCache(device, m_pipelineCachePath.empty() ? nullptr : m_pipelineCachePath.c_str(), &pipelineCache));
+    m_savedPipelineCacheSize = vk::pipelineCacheSize(device, pipelineCache);
+    LoadPipelineManifest();
+}
+
+void RenderContext::SavePipelineCache()
+{
+    SavePipelineManifest();
+
+    if (m_pipelineCachePath.empty() || pipelineCache.driverCache == VK_NULL_HANDLE)
+        return;
+
+    // the cache only ever grows, so an unchanged size means nothing new to write
+    size_t size = vk::pipelineCacheSize(device, pipelineCache);
+    if (size == m_savedPipelineCacheSize)
+        return;
+
+    // remembered even if the save fails (over the size limit), so idle frames don't keep retrying
+    vk::savePipelineCache(device, pipelineCache, m_pipelineCachePath.c_str());
+    m_savedPipelineCacheSize = size;
+}
+
+void RenderContext::LoadPipelineManifest()
+{
+    if (m_pipelineManifestPath.empty())
+        return;
+
+    // one state per line: name, color format, depth format, sample count
+    std::ifstream file(m_pipelineManifestPath);
+    PipelineManifestEntry entry;
+    int colorFormat, depthFormat, sampleCount;
+
+    while (file >> entry.name >> colorFormat >> depthFormat >> sampleCount)
+    {
+        entry.attachments.colorFormat = (VkFormat)colorFormat;
+        entry.attachments.depthFormat = (VkFormat)depthFormat;
+        entry.attachments.sampleCount = (VkSampleCountFlagBits)sampleCount;
+
+        // dropped entries disappear from the file with the next save
+        if (attachmentsSupported(device, entry.attachments))
+            m_pipelineManifest.push_back(entry);
+        else
+            m_pipelineManifestDirty = true;
+    }
+}
+
+void RenderContext::SavePipelineManifest()
+{
+    if (m_pipelineManifestPath.empty() || !m_pipelineManifestDirty)
+        return;
+
+    std::ostringstream manifest;
+    for (const PipelineManifestEntry &entry : m_pipelineManifest)
+    {
+        manifest << entry.name << " " << (int)entry.attachments.colorFormat << " " << (int)entry.attachments.depthFormat
+                 << " " << (int)entry.attachments.sampleCount << "\n";
+    }
+
+    // cleared even if writing fails, same as the pipeline cache - idle frames don't keep retrying
+    std::string data = manifest.str();
+    WriteFileAtomic(m_pipelineManifestPath.c_str(), data.data(), data.size());
+    m_pipelineManifestDirty = false;
+}
+
+void RenderContext::RetireReplacedPipelines()
+{
+    for (VkPipeline pipeline : m_pipelineCompiler.retired)
+        DeferDestroy(vk::DeletionQueue::PIPELINE, (uint64_t)pipeline);
+
+    m_pipelineCompiler.retired.clear();
+}
+
+vk::PipelineHandle RenderContext::CompilePipeline(const char *name, const VkDescriptorSetLayout &descriptorLayout, const vk::VertexBufferInfo *vbInfo, const vk::Pipeline &pipeline, const char **shaders)
+{
+    vk::PipelineHandle handle = vk::compilePipeline(device, m_pipelineCompiler, swapChain, activeAttachments, descriptorLayout, vbInfo, pipeline, shaders);
+
+    bool listed = false;
+    bool warmUp = warmUpPipelines && std::find(m_warmedUpPipelines.begin(), m_warmedUpPipelines.end(), name) == m_warmedUpPipelines.end();
+
+    // queued behind the pipeline needed right now - handles aren't kept, the results land in the cache (AA mode switches become lookups)
+    for (const PipelineManifestEntry &entry : m_pipelineManifest)
+    {
+        if (entry.name != name)
+            continue;
+
+        if (sameAttachments(entry.attachments, activeAttachments))
+            listed = true;
+        else if (warmUp)
+            vk::compilePipeline(device, m_pipelineCompiler, swapChain, entry.attachments, descriptorLayout, vbInfo, pipeline, shaders);
+    }
+
+    if (warmUp)
+        m_warmedUpPipelines.push_back(name);
+
+    if (!listed)
+    {
+        m_pipelineManifest.push_back({ name, activeAttachments });
+        m_pipelineManifestDirty = true;
+    }
 
-    VK_VERIFY(vkCreatePipelineCache(device.logical, &pcInfo, nullptr, &pipelineCache));
+    return handle;
 }
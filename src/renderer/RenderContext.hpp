@@ -4,21 +4,43 @@
 #include "Math.hpp"
 #include "renderer/vulkan/Buffers.hpp"
 #include "renderer/vulkan/CmdBuffer.hpp"
+#include "renderer/vulkan/DeletionQueue.hpp"
 #include "renderer/vulkan/Device.hpp"
+#include "renderer/vulkan/FrameContext.hpp"
 #include "renderer/vulkan/Image.hpp"
 #include "renderer/vulkan/Pipeline.hpp"
+#include "renderer/vulkan/PipelineCache.hpp"
+#include "renderer/vulkan/PipelineCompiler.hpp"
+#include "renderer/vulkan/RenderGraph.hpp"
 #include <SDL.h>
 #include <SDL_vulkan.h>
+#include <deque>
+#include <functional>
+#include <string>
 
 // SDL-based Vulkan setup container ("render context")
 class RenderContext
 {
 public:
-    bool Init(const char *title, int x, int y, int w, int h);
+    // frames in flight trade latency (1) for CPU/GPU overlap (up to MAX_FRAMES_IN_FLIGHT)
+    static const int MAX_FRAMES_IN_FLIGHT = 4;
+
+    // anti-aliasing policy - MSAA modes render to multisampled targets, FXAA filters the finished frame in a fullscreen pass
+    enum AAMode
+    {
+        AA_NONE,
+        AA_MSAA_2X,
+        AA_MSAA_4X,
+        AA_MSAA_8X,
+        AA_FXAA,
+        AA_MODE_COUNT
+    };
+
+    bool Init(const char *title, int x, int y, int w, int h, int framesInFlight = 2);
     void Destroy();
 
-    // start rendering frame and setup all necessary structs
-    VkResult RenderStart();
+    // start rendering frame and setup all necessary structs - frame receives the context of the frame being recorded
+    VkResult RenderStart(vk::FrameContext **frame = nullptr);
     // command buffer submission to render queue
     VkResult Submit();
     // render queue presentation
@@ -27,17 +49,76 @@ public:
     Math::Vector2f WindowSize();
     // rebuild entire swap chain
     bool RecreateSwapChain();
-    // toggle MSAA on/off, return current setting
-    VkSampleCountFlagBits ToggleMSAA();
+    // coalesce rebuild requests (resize events, suboptimal swapchain) - the swapchain is rebuilt once at the start of the next frame
+    void RequestSwapChainRebuild() { m_swapChainDirty = true; }
+    // switch anti-aliasing mode (render pipelines built for activeAttachments need a rebuild afterwards) - false if unsupported
+    bool SetAAMode(AAMode mode);
+    // cycle to the next anti-aliasing mode supported by the device, return the new mode
+    AAMode NextAAMode();
+    bool AAModeSupported(AAMode mode) const;
+    AAMode ActiveAAMode() const { return m_aaMode; }
+    static const char *AAModeName(AAMode mode);
+    // GPU time of the most recently completed frame in milliseconds, negative if timestamps aren't supported
+    float GpuFrameTime() const { return m_gpuFrameTime; }
+    // present mode and image count changes take effect with a swapchain rebuild at the start of the next frame
+    bool SetPresentMode(VkPresentModeKHR mode);
+    // cycle through FIFO, FIFO relaxed, mailbox and immediate (skipping unsupported ones), return the new mode
+    VkPresentModeKHR NextPresentMode();
+    bool PresentModeSupported(VkPresentModeKHR mode) const;
+    VkPresentModeKHR ActivePresentMode() const { return swapChain.presentMode; }
+    static const char *PresentModeName(VkPresentModeKHR mode);
+    void SetSwapChainImageCount(uint32_t count);
+    // latency limiter: number of submitted frames the GPU may still be working on when the next one starts (1 to frames in flight)
+    void SetMaxQueuedFrames(int count);
+    int  MaxQueuedFrames() const { return m_maxQueuedFrames; }
+    // call right before sampling input - blocks until the queue is below the limit, so the frame starts with the most recent input
+    void WaitForFrameLatency();
+    // interval between the last two presents and estimated input-to-photon latency in milliseconds, negative until measured
+    float PresentInterval() const { return m_presentInterval; }
+    float InputLatency() const { return m_inputLatency; }
+    // late latching: the matrix (in the active frame's transient memory) is overwritten with ModelViewProjectionMatrix right before submission
+    void LateLatchMatrix(Math::Matrix4f *transientMatrix);
+    // write the pipeline cache to disk if it grew since it was loaded or last saved - cheap to call while idle, also done on Destroy()
+    // (along with the manifest of pipeline states to warm up on the next run)
+    void SavePipelineCache();
+    // compile a pipeline for activeAttachments in the background - draws using it are skipped until it's ready.
+    // name identifies the pipeline in the warm-up manifest: the first request for it also queues the other attachments it was used with before
+    vk::PipelineHandle CompilePipeline(const char *name, const VkDescriptorSetLayout &descriptorLayout, const vk::VertexBufferInfo *vbInfo, const vk::Pipeline &pipeline, const char **shaders);
+
+    // hand over GPU objects frames in flight may still use - they're destroyed once those frames have finished
+    template<typename T>
+    void DeferDestroy(T &resource) { vk::deferDestroy(m_deletionQueue, m_frameTimeline.value + 1, resource); }
+    void DeferDestroy(vk::DeletionQueue::ResourceType type, uint64_t handle) { vk::deferDestroy(m_deletionQueue, m_frameTimeline.value + 1, type, handle); }
+
+    int FramesInFlight() const { return (int)m_frames.size(); }
+    // buffer backing the transient memory of all frames (for descriptors using dynamic offsets)
+    const vk::Buffer &TransientBuffer() const { return m_transientBuffer; }
 
     SDL_Window *window = nullptr;
+    // set before Init() to force the binary semaphore + fence path even if timeline semaphores are supported
+    bool allowTimelineSemaphores = true;
+    // set before Init() to fall back to render passes with imageless (or, with both disabled, per-image) framebuffers
+    bool allowDynamicRendering = true;
+    bool allowImagelessFramebuffer = true;
+    // set before Init() to always build monolithic pipelines, even if graphics pipeline libraries are supported
+    bool allowPipelineLibrary = true;
+    // set before Init() to bake cull mode, topology, depth, blend and sample count into pipelines even if they could be dynamic
+    bool allowDynamicState = true;
+    // refresh ModelViewProjectionMatrix from the latest input before late-latched matrices are written - no effect while disabled
+    bool lateLatching = false;
+    std::function<void()> lateLatchUpdate;
+    // compile pipeline states listed in the manifest of earlier runs ahead of use
+    bool warmUpPipelines = true;
 
     // Vulkan global objects
     vk::Device device;
     vk::SwapChain swapChain;
-    vk::RenderPass activeRenderPass;
+    // attachments rendered to between RenderStart() and Submit() - pipelines used there are built against these
+    vk::AttachmentFormats activeAttachments;
     VkCommandBuffer activeCmdBuffer = VK_NULL_HANDLE;
-    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    vk::FrameContext *activeFrame = nullptr;
+    // shared by all pipelines - rebuilding one with unchanged state (AA mode toggled back) is a lookup
+    vk::PipelineCache pipelineCache;
 
     float fov = 75.f * PIdiv180;
     float nearPlane = 0.1f;
@@ -56,16 +137,44 @@ public:
 
     Math::Matrix4f ModelViewProjectionMatrix; // global MVP used to orient the entire world
 private:
+    // attachment of the scene or post-processing pass, in render pass order
+    struct PassAttachment
+    {
+        VkImageView view;
+        VkFormat    format;
+        VkImageUsageFlags usage;
+        VkExtent2D  extent;
+    };
+
     bool InitVulkan(const char *appTitle);
     void CreateDrawBuffers();
+    // declare the passes of the active AA mode and let the graph allocate their transient targets
+    void BuildRenderGraph();
     void DestroyDrawBuffers();
     bool CreateImageViews();
     void DestroyImageViews();
     std::vector<VkFramebuffer> CreateFramebuffers(const vk::RenderPass &rp);
     void DestroyFramebuffers();
-    void CreateFences();
-    void CreateSemaphores();
+    // render passes are built the first time their mode is used (not at all with dynamic rendering)
+    const vk::RenderPass &AARenderPass(AAMode mode);
+    void SelectAttachments(AAMode mode);
+    uint32_t PassAttachments(bool postPass, uint32_t imageIndex, PassAttachment *attachments) const;
+    // begin/end the scene or post-processing pass with whichever of dynamic rendering/imageless/regular framebuffers is in use
+    void BeginPass(VkCommandBuffer cmdBuffer, bool postPass);
+    void EndPass(VkCommandBuffer cmdBuffer, bool postPass);
+    void CreatePostProcess();
+    void UpdatePostDescriptor();
+    void RecordPostProcess(VkCommandBuffer cmdBuffer);
+    void ReadGpuTimestamps(vk::FrameContext &frame);
+    void UpdateInputLatency();
     void CreatePipelineCache();
+    void LoadPipelineManifest();
+    void SavePipelineManifest();
+    void RetireReplacedPipelines();
+    // block until the frame submission that signaled value has finished on the GPU
+    void WaitForFrame(uint64_t value);
+    // highest frame timeline value known to have finished on the GPU
+    uint64_t CompletedFrameValue();
 
     // Vulkan instance and surface
     VkInstance   m_instance = VK_NULL_HANDLE;
@@ -75,35 +184,85 @@ private:
     VkViewport m_viewport = {};
     VkRect2D   m_scissor  = {};
 
-    // Vulkan render passes - we don't want to rebuild them mid-flight when toggling MSAA due to issues in full screen (black screen, blinking, etc.)
-    vk::RenderPass m_renderPass;
-    vk::RenderPass m_msaaRenderPass;
+    // Vulkan render passes, one per AA mode - we don't want to rebuild them mid-flight when switching modes due to issues in full screen (black screen, blinking, etc.)
+    vk::RenderPass m_renderPasses[AA_MODE_COUNT];
+    vk::RenderPass m_activeRenderPass;
+    AAMode m_aaMode = AA_NONE;
 
-    // Vulkan framebuffers
+    // Vulkan framebuffers for the active render pass - one per swapchain image, a single one if imageless, none with dynamic rendering
     std::vector<VkFramebuffer> m_frameBuffers;
-    std::vector<VkFramebuffer> m_msaaFrameBuffers;
+
+    // FXAA: the scene is rendered to m_postColor, then filtered into the swapchain image by a fullscreen pass
+    vk::RenderPass m_postRenderPass;
+    std::vector<VkFramebuffer> m_postFrameBuffers;
+    vk::Pipeline m_fxaaPipeline;
+    vk::Descriptor m_fxaaDescriptor;
+
+    // begin/end timestamps of each frame in flight
+    VkQueryPool m_timestampPool = VK_NULL_HANDLE;
+    float m_gpuFrameTime = -1.f;
+
+    // latency limiter and measurements (SDL performance counter ticks)
+    int m_maxQueuedFrames = 2;
+    Uint64 m_inputTime = 0;
+    Uint64 m_lastPresentTime = 0;
+    // input sampling time of each submitted frame, until it's seen finished on the GPU
+    std::deque<std::pair<uint64_t, Uint64>> m_inputTimes;
+    // per-user pipeline cache file (empty if there's no writable location) and the cache size last written to/read from it
+    std::string m_pipelineCachePath;
+    size_t m_savedPipelineCacheSize = 0;
+
+    // pipeline states (by name and attachments) requested in this and earlier runs
+    struct PipelineManifestEntry
+    {
+        std::string name;
+        vk::AttachmentFormats attachments;
+    };
+
+    vk::PipelineCompiler m_pipelineCompiler;
+    std::vector<PipelineManifestEntry> m_pipelineManifest;
+    std::string m_pipelineManifestPath;
+    bool m_pipelineManifestDirty = false;
+    // names already warmed up this run
+    std::vector<std::string> m_warmedUpPipelines;
+
+    // matrices of the frame being recorded that get the late-latched MVP
+    std::vector<Math::Matrix4f *> m_lateLatches;
+    float m_presentInterval = -1.f;
+    float m_inputLatency = -1.f;
 
     // Vulkan image views
     std::vector<VkImageView> m_imageViews;
 
-    // use 2 synchronized command buffers for rendering (double buffering)
-    static const int NUM_CMDBUFFERS = 2;
+    // per-frame command buffers, sync objects and transient memory
+    std::vector<vk::FrameContext> m_frames;
+    vk::Buffer m_transientBuffer;
+    int m_framesInFlight = 2;
+    int m_currentFrame = 0;
+    // every frame submission gets the next value - signaled on the GPU with timeline semaphores, otherwise only counted
+    vk::Timeline m_frameTimeline;
+    // submission that last rendered to each swapchain image (there may be more frames in flight than images)
+    std::vector<uint64_t> m_imageSubmitValues;
+    // binary fallback only - tracked by polling frame fences
+    uint64_t m_completedFrameValue = 0;
+    // objects released while still in use by frames in flight
+    vk::DeletionQueue m_deletionQueue;
 
-    // command buffers
-    std::vector<VkCommandBuffer> m_commandBuffers;
-    // command buffer double buffering fences
-    VkFence m_fences[NUM_CMDBUFFERS];
-    // semaphore: signal when next image is available for rendering
-    VkSemaphore m_imageAvailableSemaphores[NUM_CMDBUFFERS];
-    // semaphore: signal when rendering to current command buffer is complete
-    VkSemaphore m_renderFinishedSemaphores[NUM_CMDBUFFERS];
+    // swapchain rebuild pending
+    bool m_swapChainDirty = false;
 
-    // depth buffer
-    vk::Texture m_depthBuffer;
+    // passes of the frame and their draw buffers - barriers between them are recorded by the graph
+    vk::RenderGraph m_renderGraph;
+    uint32_t m_swapChainTarget = 0;
 
-    // render targets for color and depth used with MSAA
+    // draw buffers of the active AA mode, owned by m_renderGraph: depth, multisampled color (MSAA) and the scene target (FXAA)
+    vk::Texture m_depthBuffer;
     vk::Texture m_msaaColor;
-    vk::Texture m_msaaDepthBuffer;
+    vk::Texture m_postColor;
+    // AA mode the draw buffers above were allocated for
+    AAMode m_drawBufferMode = AA_NONE;
+    // allocated size of the draw buffers above - reused while the swapchain fits
+    VkExtent2D m_drawBufferExtent = { 0, 0 };
 
     // handle submission from multiple render passes
     uint32_t m_imageIndex;
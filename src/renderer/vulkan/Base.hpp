@@ -12,6 +12,8 @@ struct SDL_Window;
 
 #include <vulkan/vulkan.h>
 #include "renderer/vulkan/vk_mem_alloc.h"
+#include <utility>
+#include <vector>
 
 // fetch and call Vulkan extension function
 #define callVkF(func, inst, ...) ((PFN_##func)vkGetInstanceProcAddr(inst, #func))(inst, __VA_ARGS__)
@@ -29,6 +31,21 @@ struct SDL_Window;
 
 namespace vk
 {
+    // GPU progress counter backed by a timeline semaphore - each submission signals a higher value
+    struct Timeline
+    {
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        uint64_t    value = 0; // last value handed out to a submission
+    };
+
+    // formats of the attachments a pipeline renders to - a multisampled color attachment is resolved to a single sampled one of the same format
+    struct AttachmentFormats
+    {
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED; // undefined - no depth attachment
+        VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    };
+
     // Vulkan device
     struct Device
     {
@@ -46,6 +63,41 @@ namespace vk
         int graphicsFamilyIndex = -1; // physical device queue family index
         int presentFamilyIndex  = -1; // physical device presentation family index
         int transferFamilyIndex = -1;
+
+        // VK_KHR_timeline_semaphore - if unavailable, binary semaphores and fences are used instead
+        bool timelineSemaphores = false;
+        PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+
+        // sync of one-off command submissions (uploads, layout transitions)
+        mutable Timeline uploadTimeline;
+        VkFence uploadFence = VK_NULL_HANDLE; // binary fallback
+
+        // VK_KHR_dynamic_rendering - attachments are bound when recording, no VkRenderPass/VkFramebuffer objects needed
+        bool dynamicRendering = false;
+        PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+        PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+        // VK_KHR_imageless_framebuffer - used without dynamic rendering: one framebuffer per pass instead of one per swapchain image
+        bool imagelessFramebuffer = false;
+        // VK_EXT_graphics_pipeline_library - pipeline state is compiled in parts, new combinations of them only need linking
+        bool graphicsPipelineLibrary = false;
+        // VK_EXT_extended_dynamic_state - cull mode, front face, topology (within its class) and depth state are set when recording
+        bool extendedDynamicState = false;
+        PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+        PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace = nullptr;
+        PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+        PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+        PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+        PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
+        // VK_EXT_extended_dynamic_state3 - sample count (dynamic rendering only, render passes fix it) and blending
+        bool dynamicRasterizationSamples = false;
+        bool dynamicColorBlend = false;
+        PFN_vkCmdSetRasterizationSamplesEXT cmdSetRasterizationSamples = nullptr;
+        PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable = nullptr;
+        PFN_vkCmdSetColorBlendEquationEXT cmdSetColorBlendEquation = nullptr;
+
+        // without dynamic rendering, pipelines are created against these - one per distinct set of attachment formats
+        mutable std::vector<std::pair<AttachmentFormats, VkRenderPass>> compatibleRenderPasses;
     };
 
     // Vulkan descriptor
@@ -1,4 +1,5 @@
 #include "renderer/vulkan/CmdBuffer.hpp"
+#include "renderer/vulkan/Sync.hpp"
 #include "Utils.hpp"
 
 namespace vk
@@ -21,16 +22,30 @@ namespace vk
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        VkFenceCreateInfo fCreateInfo = {};
-        fCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        // submission is synchronous - wait for the next upload timeline value or reuse the device's upload fence
+        if (device.timelineSemaphores)
+        {
+            uint64_t signalValue = device.uploadTimeline.value + 1;
+
+            VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &signalValue;
 
-        VkFence queueFence;
-        vkCreateFence(device.logical, &fCreateInfo, nullptr, &queueFence);
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &device.uploadTimeline.semaphore;
 
-        vkQueueSubmit(queue, 1, &submitInfo, queueFence);
- 
-        vkWaitForFences(device.logical, 1, &queueFence, VK_TRUE, UINT64_MAX);
-        vkDestroyFence(device.logical, queueFence, nullptr);
+            VK_VERIFY(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+            device.uploadTimeline.value = signalValue;
+            VK_VERIFY(waitTimeline(device, device.uploadTimeline, signalValue));
+        }
+        else
+        {
+            VK_VERIFY(vkQueueSubmit(queue, 1, &submitInfo, device.uploadFence));
+            VK_VERIFY(vkWaitForFences(device.logical, 1, &device.uploadFence, VK_TRUE, UINT64_MAX));
+            VK_VERIFY(vkResetFences(device.logical, 1, &device.uploadFence));
+        }
     }
 
     VkResult createCommandPool(const Device &device, uint32_t queueFamilyIndex, VkCommandPool *commandPool)
@@ -0,0 +1,108 @@
+#include "renderer/vulkan/DeletionQueue.hpp"
+
+namespace vk
+{
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, DeletionQueue::ResourceType type, uint64_t handle, VmaAllocation allocation)
+    {
+        if (handle == 0)
+            return;
+
+        LOG_MESSAGE_ASSERT(queue.entries.empty() || queue.entries.back().retireValue <= retireValue, "Deletion queue retire values must not decrease!");
+        queue.entries.push_back({ retireValue, type, handle, allocation });
+    }
+
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Pipeline &pipeline)
+    {
+        // owned by the cache, which outlives every frame
+        if (pipeline.cache)
+        {
+            pipeline.pipeline = VK_NULL_HANDLE;
+            pipeline.layout = VK_NULL_HANDLE;
+            return;
+        }
+
+        deferDestroy(queue, retireValue, DeletionQueue::PIPELINE, (uint64_t)pipeline.pipeline);
+        deferDestroy(queue, retireValue, DeletionQueue::PIPELINE_LAYOUT, (uint64_t)pipeline.layout);
+        pipeline.pipeline = VK_NULL_HANDLE;
+        pipeline.layout = VK_NULL_HANDLE;
+    }
+
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Buffer &buffer)
+    {
+        deferDestroy(queue, retireValue, DeletionQueue::BUFFER, (uint64_t)buffer.buffer, buffer.allocation);
+        buffer.buffer = VK_NULL_HANDLE;
+        buffer.allocation = VK_NULL_HANDLE;
+    }
+
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Texture &texture)
+    {
+        // view goes first so it's never left pointing at a destroyed image
+        deferDestroy(queue, retireValue, DeletionQueue::IMAGE_VIEW, (uint64_t)texture.imageView);
+        deferDestroy(queue, retireValue, DeletionQueue::SAMPLER, (uint64_t)texture.sampler);
+        deferDestroy(queue, retireValue, DeletionQueue::IMAGE, (uint64_t)texture.image, texture.allocation);
+        texture.imageView = VK_NULL_HANDLE;
+        texture.sampler = VK_NULL_HANDLE;
+        texture.image = VK_NULL_HANDLE;
+        texture.allocation = VK_NULL_HANDLE;
+    }
+
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Descriptor &descriptor)
+    {
+        // sets are freed along with the pool
+        deferDestroy(queue, retireValue, DeletionQueue::DESCRIPTOR_POOL, (uint64_t)descriptor.pool);
+        deferDestroy(queue, retireValue, DeletionQueue::DESCRIPTOR_SET_LAYOUT, (uint64_t)descriptor.setLayout);
+        descriptor.pool = VK_NULL_HANDLE;
+        descriptor.setLayout = VK_NULL_HANDLE;
+        descriptor.set = VK_NULL_HANDLE;
+    }
+
+    void flushDeletionQueue(const Device &device, DeletionQueue &queue, uint64_t completedValue)
+    {
+        while (!queue.entries.empty() && queue.entries.front().retireValue <= completedValue)
+        {
+            const DeletionQueue::Entry &e = queue.entries.front();
+
+            switch (e.type)
+            {
+            case DeletionQueue::PIPELINE:
+                vkDestroyPipeline(device.logical, (VkPipeline)e.handle, nullptr);
+                break;
+            case DeletionQueue::PIPELINE_LAYOUT:
+                vkDestroyPipelineLayout(device.logical, (VkPipelineLayout)e.handle, nullptr);
+                break;
+            case DeletionQueue::BUFFER:
+                vmaDestroyBuffer(device.allocator, (VkBuffer)e.handle, e.allocation);
+                break;
+            case DeletionQueue::IMAGE:
+                vmaDestroyImage(device.allocator, (VkImage)e.handle, e.allocation);
+                break;
+            case DeletionQueue::IMAGE_VIEW:
+                vkDestroyImageView(device.logical, (VkImageView)e.handle, nullptr);
+                break;
+            case DeletionQueue::SAMPLER:
+                vkDestroySampler(device.logical, (VkSampler)e.handle, nullptr);
+                break;
+            case DeletionQueue::FRAMEBUFFER:
+                vkDestroyFramebuffer(device.logical, (VkFramebuffer)e.handle, nullptr);
+                break;
+            case DeletionQueue::RENDER_PASS:
+                vkDestroyRenderPass(device.logical, (VkRenderPass)e.handle, nullptr);
+                break;
+            case DeletionQueue::DESCRIPTOR_POOL:
+                vkDestroyDescriptorPool(device.logical, (VkDescriptorPool)e.handle, nullptr);
+                break;
+            case DeletionQueue::DESCRIPTOR_SET_LAYOUT:
+                vkDestroyDescriptorSetLayout(device.logical, (VkDescriptorSetLayout)e.handle, nullptr);
+                break;
+            case DeletionQueue::SWAPCHAIN:
+                vkDestroySwapchainKHR(device.logical, (VkSwapchainKHR)e.handle, nullptr);
+                break;
+            case DeletionQueue::MEMORY:
+                vmaFreeMemory(device.allocator, e.allocation);
+                break;
+            }
+
+            queue.entries.pop_front();
+        }
+    }
+}
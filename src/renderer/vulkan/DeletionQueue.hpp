@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer/vulkan/Base.hpp"
+#include "renderer/vulkan/Buffers.hpp"
+#include "renderer/vulkan/Image.hpp"
+#include "renderer/vulkan/Pipeline.hpp"
+#include <deque>
+
+/*
+ *  Deferred destruction of GPU objects that may still be referenced by frames in flight
+ */
+
+namespace vk
+{
+    struct DeletionQueue
+    {
+        enum ResourceType
+        {
+            PIPELINE,
+            PIPELINE_LAYOUT,
+            BUFFER,
+            IMAGE,
+            IMAGE_VIEW,
+            SAMPLER,
+            FRAMEBUFFER,
+            RENDER_PASS,
+            DESCRIPTOR_POOL,
+            DESCRIPTOR_SET_LAYOUT,
+            SWAPCHAIN,
+            MEMORY       // allocation shared by several images, handle is the allocation itself
+        };
+
+        struct Entry
+        {
+            uint64_t      retireValue; // frame timeline value after which the GPU no longer uses the resource
+            ResourceType  type;
+            uint64_t      handle;      // non-dispatchable handles are 64-bit on every platform
+            VmaAllocation allocation;  // buffers, images and memory only
+        };
+
+        // retire values never decrease, so entries are ordered by them
+        std::deque<Entry> entries;
+    };
+
+    // handles are reset to VK_NULL_HANDLE once queued
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, DeletionQueue::ResourceType type, uint64_t handle, VmaAllocation allocation = VK_NULL_HANDLE);
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Pipeline &pipeline);
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Buffer &buffer);
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Texture &texture);
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, Descriptor &descriptor);
+    // destroy everything retired at or before completedValue (UINT64_MAX flushes the whole queue - device must be idle)
+    void flushDeletionQueue(const Device &device, DeletionQueue &queue, uint64_t completedValue);
+}
@@ -1,7 +1,9 @@
 #include "renderer/vulkan/Device.hpp"
+#include "renderer/vulkan/Sync.hpp"
 #include "renderer/vulkan/Validation.hpp"
 #include "Utils.hpp"
 #include <algorithm>
+#include <iterator>
 
 namespace vk
 {
@@ -23,31 +25,131 @@ namespace vk
 
     // requested device extensions
     static std::vector<const char *> devExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    // optional extensions along with the ones they depend on (promoted to core in Vulkan 1.2, but devices may only support 1.1)
+    static const char *dynamicRenderingExtensions[] = { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME };
+    static const char *imagelessFramebufferExtensions[] = { VK_KHR_IMAGELESS_FRAMEBUFFER_EXTENSION_NAME, VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME };
+    static const char *pipelineLibraryExtensions[] = { VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME };
+    static const char *timelineExtension = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+    static const char *extendedDynamicStateExtension = VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME;
+    static const char *extendedDynamicState3Extension = VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME;
 
     // internal helper functions for device and swapchain creation
     static VkResult selectPhysicalDevice(const VkInstance &instance, const VkSurfaceKHR &surface, Device *device);
     static VkResult createLogicalDevice(Device *device);
     static void getBestPhysicalDevice(const VkPhysicalDevice *devices, size_t count, const VkSurfaceKHR &surface, Device *device);
     static bool deviceExtensionsSupported(const VkPhysicalDevice &device, const char **requested, size_t count);
+    static bool featureQuerySupported(const VkPhysicalDevice &device);
+    // false if the extensions or the feature query are unavailable - otherwise featureStruct (sType set) is filled through vkGetPhysicalDeviceFeatures2
+    static bool queryFeatures(const VkInstance &instance, const VkPhysicalDevice &device, const char **extensions, size_t count, void *featureStruct);
+    static bool timelineSemaphoresSupported(const VkInstance &instance, const VkPhysicalDevice &device);
+    static bool dynamicRenderingSupported(const VkInstance &instance, const VkPhysicalDevice &device);
+    static bool imagelessFramebufferSupported(const VkInstance &instance, const VkPhysicalDevice &device);
+    static bool pipelineLibrarySupported(const VkInstance &instance, const VkPhysicalDevice &device, bool *fastLinking);
+    static bool extendedDynamicStateSupported(const VkInstance &instance, const VkPhysicalDevice &device);
+    static void extendedDynamicState3Supported(const VkInstance &instance, const VkPhysicalDevice &device, bool *rasterizationSamples, bool *colorBlend);
     static void getSwapChainInfo(const VkPhysicalDevice devices, const VkSurfaceKHR &surface, SwapChainInfo *scInfo);
     static void getSwapSurfaceFormat(const SwapChainInfo &scInfo, VkSurfaceFormatKHR *surfaceFormat);
     static void getSwapPresentMode(const SwapChainInfo &scInfo, VkPresentModeKHR *presentMode);
     static void getSwapExtent(const SwapChainInfo &scInfo, VkExtent2D *swapExtent, const VkExtent2D &currentSize);
     static VkCompositeAlphaFlagBitsKHR getSupportedCompositeAlpha(VkCompositeAlphaFlagsKHR supportedFlags);
 
-    Device createDevice(const VkInstance &instance, const VkSurfaceKHR &surface)
+    Device createDevice(const VkInstance &instance, const VkSurfaceKHR &surface, bool allowTimelineSemaphores, bool allowDynamicRendering, bool allowImagelessFramebuffer, bool allowPipelineLibrary, bool allowDynamicState)
     {
         Device device;
+        bool fastLinking = false;
         VK_VERIFY(selectPhysicalDevice(instance, surface, &device));
+        device.timelineSemaphores = allowTimelineSemaphores && timelineSemaphoresSupported(instance, device.physical);
+        device.dynamicRendering = allowDynamicRendering && dynamicRenderingSupported(instance, device.physical);
+        device.imagelessFramebuffer = !device.dynamicRendering && allowImagelessFramebuffer && imagelessFramebufferSupported(instance, device.physical);
+        device.graphicsPipelineLibrary = allowPipelineLibrary && pipelineLibrarySupported(instance, device.physical, &fastLinking);
+        device.extendedDynamicState = allowDynamicState && extendedDynamicStateSupported(instance, device.physical);
+        if (device.extendedDynamicState)
+        {
+            extendedDynamicState3Supported(instance, device.physical, &device.dynamicRasterizationSamples, &device.dynamicColorBlend);
+            // pipelines are tied to a render pass of a fixed sample count
+            device.dynamicRasterizationSamples &= device.dynamicRendering;
+        }
         VK_VERIFY(createLogicalDevice(&device));
 
         vkGetDeviceQueue(device.logical, device.graphicsFamilyIndex, 0, &device.graphicsQueue);
         vkGetDeviceQueue(device.logical, device.presentFamilyIndex, 0, &device.presentQueue);
         vkGetDeviceQueue(device.logical, device.transferFamilyIndex, 0, &device.transferQueue);
 
+        if (device.timelineSemaphores)
+        {
+            device.waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device.logical, "vkWaitSemaphoresKHR");
+            device.getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device.logical, "vkGetSemaphoreCounterValueKHR");
+            VK_VERIFY(createTimeline(device, &device.uploadTimeline));
+            LOG_MESSAGE("Using timeline semaphores");
+        }
+        else
+        {
+            VkFenceCreateInfo fCreateInfo = {};
+            fCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VK_VERIFY(vkCreateFence(device.logical, &fCreateInfo, nullptr, &device.uploadFence));
+            LOG_MESSAGE("Timeline semaphores not available - using binary semaphores and fences");
+        }
+
+        if (device.dynamicRendering)
+        {
+            device.cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device.logical, "vkCmdBeginRenderingKHR");
+            device.cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device.logical, "vkCmdEndRenderingKHR");
+            LOG_MESSAGE("Using dynamic rendering");
+        }
+        else if (device.imagelessFramebuffer)
+        {
+            LOG_MESSAGE("Dynamic rendering not available - using render passes with imageless framebuffers");
+        }
+        else
+        {
+            LOG_MESSAGE("Dynamic rendering and imageless framebuffers not available - using render passes");
+        }
+
+        if (device.graphicsPipelineLibrary)
+        {
+            LOG_MESSAGE("Using graphics pipeline libraries" << (fastLinking ? "" : " (no fast linking)"));
+        }
+
+        if (device.extendedDynamicState)
+        {
+            device.cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetCullModeEXT");
+            device.cmdSetFrontFace = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetFrontFaceEXT");
+            device.cmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetPrimitiveTopologyEXT");
+            device.cmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetDepthTestEnableEXT");
+            device.cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetDepthWriteEnableEXT");
+            device.cmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetDepthCompareOpEXT");
+            LOG_MESSAGE("Using extended dynamic state");
+        }
+
+        if (device.dynamicRasterizationSamples)
+        {
+            device.cmdSetRasterizationSamples = (PFN_vkCmdSetRasterizationSamplesEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetRasterizationSamplesEXT");
+            LOG_MESSAGE("Using dynamic rasterization samples");
+        }
+
+        if (device.dynamicColorBlend)
+        {
+            device.cmdSetColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetColorBlendEnableEXT");
+            device.cmdSetColorBlendEquation = (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(device.logical, "vkCmdSetColorBlendEquationEXT");
+            LOG_MESSAGE("Using dynamic color blending");
+        }
+
         return device;
     }
 
+    void destroyDevice(Device &device)
+    {
+        for (auto &rp : device.compatibleRenderPasses)
+            vkDestroyRenderPass(device.logical, rp.second, nullptr);
+        device.compatibleRenderPasses.clear();
+
+        destroyTimeline(device, device.uploadTimeline);
+        vkDestroyFence(device.logical, device.uploadFence, nullptr);
+        vkDestroyDevice(device.logical, nullptr);
+        device.logical = VK_NULL_HANDLE;
+        device.uploadFence = VK_NULL_HANDLE;
+    }
+
     VkResult createSwapChain(const Device &device, const VkSurfaceKHR &surface, SwapChain *swapChain, VkSwapchainKHR oldSwapchain)
     {
         SwapChainInfo scInfo = {};
@@ -66,6 +168,10 @@ namespace vk
         if (swapChain->presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
             imageCount = std::max(3, (int)scInfo.surfaceCaps.minImageCount);
 
+        // explicit count overrides the above - fewer images mean less queued frames (latency), more mean less stalling on acquire
+        if (swapChain->requestedImageCount > 0)
+            imageCount = std::max(swapChain->requestedImageCount, scInfo.surfaceCaps.minImageCount);
+
         if (scInfo.surfaceCaps.maxImageCount > 0)
             imageCount = std::min(imageCount, scInfo.surfaceCaps.maxImageCount);
 
@@ -78,6 +184,7 @@ namespace vk
         scCreateInfo.imageExtent = extent;
         scCreateInfo.imageArrayLayers = 1;
         scCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        swapChain->imageUsage = scCreateInfo.imageUsage;
         scCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         scCreateInfo.queueFamilyIndexCount = 0;
         scCreateInfo.pQueueFamilyIndices = nullptr;
@@ -106,13 +213,8 @@ namespace vk
         LOG_MESSAGE_ASSERT(imageCount != 0, "No available images in the swap chain?");
         swapChain->images.resize(imageCount);
 
-        VkResult result = vkGetSwapchainImagesKHR(device.logical, swapChain->sc, &imageCount, swapChain->images.data());
-
-        // release old swap chain if it was specified
-        if(oldSwapchain != VK_NULL_HANDLE)
-            vkDestroySwapchainKHR(device.logical, oldSwapchain, nullptr);
-
-        return result;
+        // the old swapchain is retired but not destroyed - the caller releases it once its images are no longer in use
+        return vkGetSwapchainImagesKHR(device.logical, swapChain->sc, &imageCount, swapChain->images.data());
     }
 
     VkResult selectPhysicalDevice(const VkInstance &instance, const VkSurfaceKHR &surface, Device *device)
@@ -171,11 +273,88 @@ namespace vk
             queueCreateInfo[numQueues++].queueFamilyIndex = device->transferFamilyIndex;
         }
 
+        // optional extensions are enabled on top of the required ones
+        std::vector<const char *> enabledExtensions = devExtensions;
+
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+        VkPhysicalDeviceImagelessFramebufferFeaturesKHR imagelessFeatures = {};
+        imagelessFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES_KHR;
+        imagelessFeatures.imagelessFramebuffer = VK_TRUE;
+
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures = {};
+        pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+        dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {};
+        dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        dynamicState3Features.extendedDynamicState3RasterizationSamples = device->dynamicRasterizationSamples ? VK_TRUE : VK_FALSE;
+        dynamicState3Features.extendedDynamicState3ColorBlendEnable = device->dynamicColorBlend ? VK_TRUE : VK_FALSE;
+        dynamicState3Features.extendedDynamicState3ColorBlendEquation = device->dynamicColorBlend ? VK_TRUE : VK_FALSE;
+
         VkDeviceCreateInfo deviceCreateInfo = {};
         deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         deviceCreateInfo.pEnabledFeatures = &wantedDeviceFeatures;
-        deviceCreateInfo.ppEnabledExtensionNames = devExtensions.data();
-        deviceCreateInfo.enabledExtensionCount = (uint32_t)devExtensions.size();
+
+        // feature structs of the enabled optional extensions are chained in front of each other
+        void *featureChain = nullptr;
+
+        if (device->timelineSemaphores)
+        {
+            enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineFeatures.pNext = featureChain;
+            featureChain = &timelineFeatures;
+        }
+
+        if (device->dynamicRendering)
+        {
+            enabledExtensions.insert(enabledExtensions.end(), std::begin(dynamicRenderingExtensions), std::end(dynamicRenderingExtensions));
+            dynamicRenderingFeatures.pNext = featureChain;
+            featureChain = &dynamicRenderingFeatures;
+        }
+
+        if (device->imagelessFramebuffer)
+        {
+            enabledExtensions.insert(enabledExtensions.end(), std::begin(imagelessFramebufferExtensions), std::end(imagelessFramebufferExtensions));
+            imagelessFeatures.pNext = featureChain;
+            featureChain = &imagelessFeatures;
+        }
+
+        if (device->graphicsPipelineLibrary)
+        {
+            enabledExtensions.insert(enabledExtensions.end(), std::begin(pipelineLibraryExtensions), std::end(pipelineLibraryExtensions));
+            pipelineLibraryFeatures.pNext = featureChain;
+            featureChain = &pipelineLibraryFeatures;
+        }
+
+        if (device->extendedDynamicState)
+        {
+            enabledExtensions.push_back(extendedDynamicStateExtension);
+            dynamicStateFeatures.pNext = featureChain;
+            featureChain = &dynamicStateFeatures;
+        }
+
+        if (device->dynamicRasterizationSamples || device->dynamicColorBlend)
+        {
+            enabledExtensions.push_back(extendedDynamicState3Extension);
+            dynamicState3Features.pNext = featureChain;
+            featureChain = &dynamicState3Features;
+        }
+
+        deviceCreateInfo.pNext = featureChain;
+
+        deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
+        deviceCreateInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
         deviceCreateInfo.queueCreateInfoCount = numQueues;
         deviceCreateInfo.pQueueCreateInfos = queueCreateInfo;
 
@@ -297,6 +476,96 @@ namespace vk
         return true;
     }
 
+    bool featureQuerySupported(const VkPhysicalDevice &device)
+    {
+        // the feature query is core in Vulkan 1.1 - the instance is created with the highest version the loader reports
+        uint32_t instanceVersion = VK_API_VERSION_1_0;
+        if (vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion"))
+            callVkF2(vkEnumerateInstanceVersion, NULL, &instanceVersion);
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        return instanceVersion >= VK_API_VERSION_1_1 && deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+    }
+
+    bool queryFeatures(const VkInstance &instance, const VkPhysicalDevice &device, const char **extensions, size_t count, void *featureStruct)
+    {
+        if (!deviceExtensionsSupported(device, extensions, count) || !featureQuerySupported(device))
+            return false;
+
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = featureStruct;
+        callVkF2(vkGetPhysicalDeviceFeatures2, instance, device, &features2);
+
+        return true;
+    }
+
+    bool timelineSemaphoresSupported(const VkInstance &instance, const VkPhysicalDevice &device)
+    {
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+        return queryFeatures(instance, device, &timelineExtension, 1, &timelineFeatures) && timelineFeatures.timelineSemaphore == VK_TRUE;
+    }
+
+    bool dynamicRenderingSupported(const VkInstance &instance, const VkPhysicalDevice &device)
+    {
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+        return queryFeatures(instance, device, dynamicRenderingExtensions, 3, &dynamicRenderingFeatures) && dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    }
+
+    bool imagelessFramebufferSupported(const VkInstance &instance, const VkPhysicalDevice &device)
+    {
+        VkPhysicalDeviceImagelessFramebufferFeaturesKHR imagelessFeatures = {};
+        imagelessFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGELESS_FRAMEBUFFER_FEATURES_KHR;
+
+        return queryFeatures(instance, device, imagelessFramebufferExtensions, 2, &imagelessFeatures) && imagelessFeatures.imagelessFramebuffer == VK_TRUE;
+    }
+
+    bool pipelineLibrarySupported(const VkInstance &instance, const VkPhysicalDevice &device, bool *fastLinking)
+    {
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures = {};
+        pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+        if (!queryFeatures(instance, device, pipelineLibraryExtensions, 2, &pipelineLibraryFeatures))
+            return false;
+
+        // without fast linking, linking may cost about as much as a full compile - still worth it for the shared parts
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProperties = {};
+        pipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &pipelineLibraryProperties;
+        callVkF2(vkGetPhysicalDeviceProperties2, instance, device, &properties2);
+        *fastLinking = pipelineLibraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+
+        return pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+    }
+
+    bool extendedDynamicStateSupported(const VkInstance &instance, const VkPhysicalDevice &device)
+    {
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+        dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+        return queryFeatures(instance, device, &extendedDynamicStateExtension, 1, &dynamicStateFeatures) && dynamicStateFeatures.extendedDynamicState == VK_TRUE;
+    }
+
+    void extendedDynamicState3Supported(const VkInstance &instance, const VkPhysicalDevice &device, bool *rasterizationSamples, bool *colorBlend)
+    {
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {};
+        dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+        // the extension is a collection of independent features - only the ones used here are checked
+        bool supported = queryFeatures(instance, device, &extendedDynamicState3Extension, 1, &dynamicState3Features);
+        *rasterizationSamples = supported && dynamicState3Features.extendedDynamicState3RasterizationSamples == VK_TRUE;
+        *colorBlend = supported && dynamicState3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE && dynamicState3Features.extendedDynamicState3ColorBlendEquation == VK_TRUE;
+    }
+
     void getSwapChainInfo(VkPhysicalDevice device, const VkSurfaceKHR &surface, SwapChainInfo *scInfo)
     {
         vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &scInfo->surfaceCaps);
@@ -12,12 +12,16 @@ namespace vk
     {
         VkSwapchainKHR sc = VK_NULL_HANDLE;
         VkFormat format = VK_FORMAT_UNDEFINED;
-        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR; // preferred mode, replaced with the one in use - MAX_ENUM picks the best available
+        uint32_t requestedImageCount = 0; // 0: chosen for the present mode
         VkExtent2D extent = { 0, 0 };
+        VkImageUsageFlags imageUsage = 0;
         std::vector<VkImage> images;
     };
 
 
-    Device   createDevice(const VkInstance &instance, const VkSurfaceKHR &surface);
+    // optional features are used when supported unless disallowed - dynamic rendering takes precedence over imageless framebuffers
+    Device   createDevice(const VkInstance &instance, const VkSurfaceKHR &surface, bool allowTimelineSemaphores = true, bool allowDynamicRendering = true, bool allowImagelessFramebuffer = true, bool allowPipelineLibrary = true, bool allowDynamicState = true);
+    void     destroyDevice(Device &device);
     VkResult createSwapChain(const Device &device, const VkSurfaceKHR &surface, SwapChain *swapChain, VkSwapchainKHR oldSwapchain);
 }
\ No newline at end of file
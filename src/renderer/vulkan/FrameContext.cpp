@@ -0,0 +1,97 @@
+#include "renderer/vulkan/FrameContext.hpp"
+#include "renderer/vulkan/CmdBuffer.hpp"
+#include "Utils.hpp"
+
+namespace vk
+{
+    VkResult createFrameContexts(const Device &device, uint32_t count, VkDeviceSize transientSize, Buffer *transientBuffer, std::vector<FrameContext> &frames)
+    {
+        frames.resize(count);
+
+        std::vector<VkCommandBuffer> cmdBuffers;
+        VkResult result = createCommandBuffers(device, device.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdBuffers, count);
+        if (result != VK_SUCCESS)
+            return result;
+
+        BufferOptions bOpts;
+        bOpts.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        bOpts.memFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        bOpts.vmaFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        bOpts.vmaUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+        result = createBuffer(device, transientSize * count, transientBuffer, bOpts);
+        if (result != VK_SUCCESS)
+            return result;
+
+        VmaAllocationInfo allocInfo;
+        vmaGetAllocationInfo(device.allocator, transientBuffer->allocation, &allocInfo);
+
+        VkFenceCreateInfo fCreateInfo = {};
+        fCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        // first wait on each frame must not block
+        fCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        VkSemaphoreCreateInfo sCreateInfo = {};
+        sCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            FrameContext &frame = frames[i];
+            frame.index = i;
+            frame.cmdBuffer = cmdBuffers[i];
+            frame.transient.buffer = transientBuffer->buffer;
+            frame.transient.mappedData = (uint8_t *)allocInfo.pMappedData + transientSize * i;
+            frame.transient.baseOffset = transientSize * i;
+            frame.transient.size = transientSize;
+            frame.transient.used = 0;
+
+            frame.submitValue = 0;
+
+            // with timeline semaphores the frame timeline value is waited on instead
+            if (!device.timelineSemaphores)
+                VK_VERIFY(vkCreateFence(device.logical, &fCreateInfo, nullptr, &frame.fence));
+            VK_VERIFY(vkCreateSemaphore(device.logical, &sCreateInfo, nullptr, &frame.imageAvailable));
+            VK_VERIFY(vkCreateSemaphore(device.logical, &sCreateInfo, nullptr, &frame.renderFinished));
+        }
+
+        return VK_SUCCESS;
+    }
+
+    void destroyFrameContexts(const Device &device, Buffer &transientBuffer, std::vector<FrameContext> &frames)
+    {
+        for (FrameContext &frame : frames)
+        {
+            vkFreeCommandBuffers(device.logical, device.commandPool, 1, &frame.cmdBuffer);
+            vkDestroyFence(device.logical, frame.fence, nullptr);
+            vkDestroySemaphore(device.logical, frame.imageAvailable, nullptr);
+            vkDestroySemaphore(device.logical, frame.renderFinished, nullptr);
+        }
+
+        frames.clear();
+
+        if (transientBuffer.buffer != VK_NULL_HANDLE)
+        {
+            freeBuffer(device, transientBuffer);
+            transientBuffer.buffer = VK_NULL_HANDLE;
+            transientBuffer.allocation = VK_NULL_HANDLE;
+        }
+    }
+
+    void *allocateTransient(TransientBuffer &transient, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *bufferOffset)
+    {
+        // alignment is relative to the whole buffer, which is what dynamic offsets and vertex buffer binds are checked against
+        VkDeviceSize offset = transient.baseOffset + transient.used;
+        if (alignment > 1)
+            offset = (offset + alignment - 1) / alignment * alignment;
+
+        if (offset + size > transient.baseOffset + transient.size)
+        {
+            LOG_MESSAGE_ASSERT(false, "Out of transient frame memory: " << size << " bytes requested, " << transient.size - transient.used << " left");
+            return nullptr;
+        }
+
+        transient.used = offset + size - transient.baseOffset;
+        *bufferOffset = offset;
+        return transient.mappedData + (offset - transient.baseOffset);
+    }
+}
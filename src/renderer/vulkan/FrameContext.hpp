@@ -0,0 +1,41 @@
+#pragma once
+
+#include "renderer/vulkan/Buffers.hpp"
+#include "renderer/vulkan/Device.hpp"
+#include <vector>
+
+/*
+ *  Per-frame resources for rendering with multiple frames in flight
+ */
+
+namespace vk
+{
+    // this frame's slice of a persistently mapped buffer, handed out linearly and reset when the frame is reused
+    struct TransientBuffer
+    {
+        VkBuffer     buffer = VK_NULL_HANDLE; // shared by all frames in flight
+        uint8_t     *mappedData = nullptr;    // start of this frame's slice
+        VkDeviceSize baseOffset = 0;          // slice offset within buffer
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+    };
+
+    // everything the CPU touches while recording a frame - only reused after the GPU has finished its last submission
+    struct FrameContext
+    {
+        uint32_t        index = 0;
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        uint64_t        submitValue = 0;                 // frame timeline value of the last submission (0 - never submitted)
+        VkFence         fence = VK_NULL_HANDLE;          // signaled when the GPU is done with this frame (binary fallback only)
+        VkSemaphore     imageAvailable = VK_NULL_HANDLE; // acquired swapchain image is ready to be rendered to
+        VkSemaphore     renderFinished = VK_NULL_HANDLE; // rendering is done, image can be presented
+        TransientBuffer transient;                       // uniform/vertex data written for this frame only
+        bool            timestampsWritten = false;       // GPU timestamps of the last submission wait to be read back
+    };
+
+    // transient memory of each frame is a transientSize slice of a single buffer (so that descriptors can use dynamic offsets)
+    VkResult createFrameContexts(const Device &device, uint32_t count, VkDeviceSize transientSize, Buffer *transientBuffer, std::vector<FrameContext> &frames);
+    void     destroyFrameContexts(const Device &device, Buffer &transientBuffer, std::vector<FrameContext> &frames);
+    // suballocate from transient memory - returns the mapped pointer and the offset in the shared buffer, nullptr if out of space
+    void    *allocateTransient(TransientBuffer &transient, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *bufferOffset);
+}
@@ -10,7 +10,6 @@ namespace vk
     static void copyBufferToImage(const VkCommandBuffer &cmdBuffer, const VkBuffer &buffer, const VkImage &image, uint32_t width, uint32_t height);
     static VkResult createImage(const Device &device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memUsage, Texture *texture);
     static void generateMipmaps(const VkCommandBuffer &cmdBuffer, const Texture &texture, uint32_t width, uint32_t height);
-    static VkImageAspectFlags getDepthStencilAspect(VkFormat depthFormat);
 
     void createTextureImage(const Device &device, Texture *dstTex, const unsigned char *data, uint32_t width, uint32_t height)
     {
@@ -118,9 +117,9 @@ namespace vk
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         samplerInfo.magFilter = texture->magFilter;
         samplerInfo.minFilter = texture->minFilter;
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeU = texture->addressMode;
+        samplerInfo.addressModeV = texture->addressMode;
+        samplerInfo.addressModeW = texture->addressMode;
         samplerInfo.anisotropyEnable = (texture->magFilter == texture->minFilter) && texture->minFilter == VK_FILTER_NEAREST ? VK_FALSE : VK_TRUE;
         if (device.properties.limits.maxSamplerAnisotropy == 1.f)
             samplerInfo.anisotropyEnable = VK_FALSE;
@@ -138,42 +137,6 @@ namespace vk
     }
 
     // helper functions
-    Texture createColorBuffer(const Device &device, const SwapChain &swapChain, VkSampleCountFlagBits sampleCount)
-    {
-        Texture colorTexture;
-        colorTexture.format = swapChain.format;
-        colorTexture.sampleCount = sampleCount;
-
-        VK_VERIFY(createImage(device, swapChain.extent.width, swapChain.extent.height, colorTexture.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &colorTexture));
-        VK_VERIFY(createImageView(device, colorTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, &colorTexture.imageView, colorTexture.format, colorTexture.mipLevels));
-
-        VkCommandBuffer cmdBuffer = createCommandBuffer(device, device.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-        beginCommand(cmdBuffer);
-        transitionImageLayout(device, cmdBuffer, device.graphicsQueue, colorTexture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        submitCommand(device, cmdBuffer, device.graphicsQueue);
-        vkFreeCommandBuffers(device.logical, device.commandPool, 1, &cmdBuffer);
-
-        return colorTexture;
-    }
-
-    Texture createDepthBuffer(const Device &device, const SwapChain &swapChain, VkSampleCountFlagBits sampleCount)
-    {
-        Texture depthTexture;
-        depthTexture.format = getBestDepthFormat(device);
-        depthTexture.sampleCount = sampleCount;
-
-        VK_VERIFY(createImage(device, swapChain.extent.width, swapChain.extent.height, depthTexture.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &depthTexture));
-        VK_VERIFY(createImageView(device, depthTexture.image, getDepthStencilAspect(depthTexture.format), &depthTexture.imageView, depthTexture.format, depthTexture.mipLevels));
-
-        VkCommandBuffer cmdBuffer = createCommandBuffer(device, device.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-        beginCommand(cmdBuffer);
-        transitionImageLayout(device, cmdBuffer, device.graphicsQueue, depthTexture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-        submitCommand(device, cmdBuffer, device.graphicsQueue);
-        vkFreeCommandBuffers(device.logical, device.commandPool, 1, &cmdBuffer);
-
-        return depthTexture;
-    }
-
     void transitionImageLayout(const Device &device, const VkCommandBuffer &cmdBuffer, const VkQueue &queue, const Texture &texture, const VkImageLayout &oldLayout, const VkImageLayout &newLayout)
     {
         VkPipelineStageFlags srcStage;
@@ -320,6 +283,8 @@ namespace vk
         vmallocInfo.usage = memUsage;
 
         texture->sharingMode = imageInfo.sharingMode;
+        texture->usage = usage;
+        texture->extent = { width, height };
         return vmaCreateImage(device.allocator, &imageInfo, &vmallocInfo, &texture->image, &texture->allocation, nullptr);
     }
 
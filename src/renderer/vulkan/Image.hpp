@@ -18,8 +18,11 @@ namespace vk
         VkSharingMode sharingMode = VK_SHARING_MODE_MAX_ENUM;
         VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
         VkFormat  format    = VK_FORMAT_R8G8B8A8_UNORM;
+        VkImageUsageFlags usage = 0;
+        VkExtent2D extent = { 0, 0 };
         VkFilter  minFilter = VK_FILTER_LINEAR;
         VkFilter  magFilter = VK_FILTER_LINEAR;
+        VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         // mipmap settings
         uint32_t mipLevels = 1;
         float mipLodBias = 0.f;
@@ -34,6 +37,5 @@ namespace vk
     void releaseTexture(const Device &device, Texture &texture);
     VkResult createImageView(const Device &device, const VkImage &image, VkImageAspectFlags aspectFlags, VkImageView *imageView, VkFormat format, uint32_t mipLevels);
     VkResult createTextureSampler(const Device &device, Texture *texture);
-    Texture  createColorBuffer(const Device &device, const SwapChain &swapChain, VkSampleCountFlagBits sampleCount);
-    Texture  createDepthBuffer(const Device &device, const SwapChain &swapChain, VkSampleCountFlagBits sampleCount);
+    VkImageAspectFlags getDepthStencilAspect(VkFormat depthFormat);
 }
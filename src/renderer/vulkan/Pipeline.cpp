@@ -1,6 +1,9 @@
 #include "renderer/vulkan/Pipeline.hpp"
+#include "renderer/vulkan/PipelineCache.hpp"
 #include "Utils.hpp"
 #include <fstream>
+#include <mutex>
+#include <vector>
 
 namespace vk
 {
@@ -24,24 +27,26 @@ namespace vk
         return shaderModule;
     }
 
-    static uint32_t *ReadShaderFromFile(const char *filename, size_t *buffSize)
+    // SPIR-V is a stream of 32-bit words - storing it as such keeps pCode aligned (codeSize stays in bytes)
+    static std::vector<uint32_t> ReadShaderFromFile(const char *filename, size_t *buffSize)
     {
+        std::vector<uint32_t> code;
         std::ifstream file(filename, std::ios::ate | std::ios::binary);
+        *buffSize = 0;
 
         if (!file.is_open())
         {
             LOG_MESSAGE_ASSERT(false, "Cannot open input file: " << filename);
+            return code;
         }
 
         *buffSize = (size_t)file.tellg();
-        uint32_t *outBuffer = new uint32_t[*buffSize << 2];
+        code.resize((*buffSize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
 
         file.seekg(0);
-        // is alignment ok here?
-        file.read((char*)outBuffer, *buffSize);
-        file.close();
+        file.read((char*)code.data(), *buffSize);
 
-        return outBuffer;
+        return code;
     }
 
     static ShaderProgram loadShader(const Device &device, const char* vshFilename, const char *fshFilename)
@@ -49,94 +54,364 @@ namespace vk
         size_t vShaderSize = 0, fShaderSize = 0;
         ShaderProgram shader;
 
-        uint32_t *vShaderSrc = ReadShaderFromFile(vshFilename, &vShaderSize);
-        uint32_t *fShaderSrc = ReadShaderFromFile(fshFilename, &fShaderSize);
+        std::vector<uint32_t> vShaderSrc = ReadShaderFromFile(vshFilename, &vShaderSize);
+        std::vector<uint32_t> fShaderSrc = ReadShaderFromFile(fshFilename, &fShaderSize);
 
-        shader.vertShader = createShaderModule(device, vShaderSrc, vShaderSize);
-        shader.fragShader = createShaderModule(device, fShaderSrc, fShaderSize);
-
-        delete[] vShaderSrc;
-        delete[] fShaderSrc;
+        shader.vertShader = createShaderModule(device, vShaderSrc.data(), vShaderSize);
+        shader.fragShader = createShaderModule(device, fShaderSrc.data(), fShaderSize);
 
         return shader;
     }
 
-    VkResult createPipeline(const Device &device, const SwapChain &swapChain, const RenderPass &renderPass, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, Pipeline *pipeline, const char **shaders)
+    // 64-bit FNV-1a
+    static uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    template<typename T>
+    static uint64_t hashValue(const T &value, uint64_t hash)
+    {
+        return hashBytes(&value, sizeof(T), hash);
+    }
+
+    // files are read once per path - the content hash lets pipelines tell apart different code behind the same path
+    static const PipelineCache::CachedShader *cachedShader(const Device &device, PipelineCache &cache, const char *filename)
+    {
+        auto it = cache.shaders.find(filename);
+        if (it != cache.shaders.end())
+            return &it->second;
+
+        size_t codeSize = 0;
+        std::vector<uint32_t> code = ReadShaderFromFile(filename, &codeSize);
+        if (codeSize == 0)
+            return nullptr;
+
+        PipelineCache::CachedShader shader;
+        shader.module = createShaderModule(device, code.data(), codeSize);
+        shader.contentHash = hashBytes(code.data(), codeSize);
+        if (shader.module == VK_NULL_HANDLE)
+            return nullptr;
+
+        return &(cache.shaders[filename] = shader);
+    }
+
+    // everything the created pipeline depends on - viewport and scissor are dynamic, so the swapchain extent isn't part of it
+    static uint64_t pipelineStateHash(const Pipeline &pipeline, const AttachmentFormats &attachments, VkDescriptorSetLayout descriptorLayout,
+                                      const VertexBufferInfo *vbInfo, uint64_t vertShaderHash, uint64_t fragShaderHash)
     {
-        ShaderProgram shader = loadShader(device, shaders[0], shaders[1]);
+        uint64_t hash = hashBytes(&vertShaderHash, sizeof(vertShaderHash));
+        hash = hashValue(fragShaderHash, hash);
 
-        VkPipelineShaderStageCreateInfo vssCreateInfo = {};
+        if (vbInfo)
+        {
+            hash = hashValue(vbInfo->bindingDescriptions.size(), hash);
+            hash = hashBytes(vbInfo->bindingDescriptions.data(), vbInfo->bindingDescriptions.size() * sizeof(VkVertexInputBindingDescription), hash);
+            hash = hashValue(vbInfo->attributeDescriptions.size(), hash);
+            hash = hashBytes(vbInfo->attributeDescriptions.data(), vbInfo->attributeDescriptions.size() * sizeof(VkVertexInputAttributeDescription), hash);
+        }
+
+        // set layouts are compared by handle - they have to stay alive as long as pipelines built with them are cached
+        hash = hashValue(descriptorLayout, hash);
+        hash = hashValue(pipeline.basePipelineHandle, hash);
+        hash = hashValue(pipeline.flags, hash);
+        hash = hashValue(pipeline.pushConstantRangeCount, hash);
+        if (pipeline.pushConstantRangeCount > 0)
+            hash = hashValue(pipeline.pushConstantRange, hash);
+        hash = hashValue(pipeline.mode, hash);
+        hash = hashValue(pipeline.cullMode, hash);
+        hash = hashValue(pipeline.topology, hash);
+        hash = hashValue(pipeline.blendMode, hash);
+        hash = hashValue(pipeline.depthTestEnable, hash);
+        hash = hashValue(pipeline.depthWriteEnable, hash);
+        hash = hashValue(pipeline.minSampleShading, hash);
+        hash = hashValue(attachments.colorFormat, hash);
+        hash = hashValue(attachments.depthFormat, hash);
+        hash = hashValue(attachments.sampleCount, hash);
+
+        return hash;
+    }
+
+    // graphics pipeline library parts, in PipelineBuild::partHashes order
+    enum PipelinePart
+    {
+        VERTEX_INPUT,
+        PRE_RASTERIZATION,
+        FRAGMENT_SHADER,
+        FRAGMENT_OUTPUT,
+        PIPELINE_PART_COUNT
+    };
+
+    static const VkGraphicsPipelineLibraryFlagsEXT PIPELINE_PART_FLAGS[PIPELINE_PART_COUNT] = {
+        VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+    };
+
+    // each part only hashes the state it's built from, so that e.g. switching MSAA modes reuses the vertex input and pre-rasterization parts
+    static void pipelinePartHashes(const Device &device, const Pipeline &pipeline, const AttachmentFormats &attachments, VkDescriptorSetLayout descriptorLayout,
+                                   const VertexBufferInfo *vbInfo, uint64_t vertShaderHash, uint64_t fragShaderHash, uint64_t *partHashes)
+    {
+        uint64_t hash = hashBytes(&pipeline.topology, sizeof(pipeline.topology));
+        if (vbInfo)
+        {
+            hash = hashValue(vbInfo->bindingDescriptions.size(), hash);
+            hash = hashBytes(vbInfo->bindingDescriptions.data(), vbInfo->bindingDescriptions.size() * sizeof(VkVertexInputBindingDescription), hash);
+            hash = hashValue(vbInfo->attributeDescriptions.size(), hash);
+            hash = hashBytes(vbInfo->attributeDescriptions.data(), vbInfo->attributeDescriptions.size() * sizeof(VkVertexInputAttributeDescription), hash);
+        }
+        partHashes[VERTEX_INPUT] = hash;
+
+        // pipeline layout and (without dynamic rendering) render pass are shared by the shader parts
+        uint64_t shared = hashBytes(&descriptorLayout, sizeof(descriptorLayout));
+        shared = hashValue(pipeline.pushConstantRangeCount, shared);
+        if (pipeline.pushConstantRangeCount > 0)
+            shared = hashValue(pipeline.pushConstantRange, shared);
+        if (!device.dynamicRendering)
+        {
+            shared = hashValue(attachments.colorFormat, shared);
+            shared = hashValue(attachments.depthFormat, shared);
+        }
+
+        // multisample state is given to both fragment parts and has to match between them
+        uint64_t multisample = hashBytes(&attachments.sampleCount, sizeof(attachments.sampleCount));
+        multisample = hashValue(pipeline.minSampleShading, multisample);
+
+        hash = hashValue(vertShaderHash, shared);
+        hash = hashValue(pipeline.mode, hash);
+        partHashes[PRE_RASTERIZATION] = hashValue(pipeline.cullMode, hash);
+
+        hash = hashValue(fragShaderHash, shared);
+        hash = hashValue(multisample, hash);
+        hash = hashValue(pipeline.depthTestEnable, hash);
+        partHashes[FRAGMENT_SHADER] = hashValue(pipeline.depthWriteEnable, hash);
+
+        hash = hashValue(pipeline.blendMode, multisample);
+        hash = hashValue(attachments.colorFormat, hash);
+        partHashes[FRAGMENT_OUTPUT] = hashValue(attachments.depthFormat, hash);
+
+        // parts of different kinds never share a key
+        for (int part = 0; part < PIPELINE_PART_COUNT; ++part)
+            partHashes[part] = hashValue(part, partHashes[part]);
+    }
+
+    // dynamic state is reset to fixed values before hashing and building, so its permutations map to the same pipeline
+    static void removeDynamicState(const Device &device, Pipeline *pipeline, AttachmentFormats *attachments)
+    {
+        if (device.extendedDynamicState)
+        {
+            pipeline->cullMode = VK_CULL_MODE_NONE;
+            pipeline->depthTestEnable = VK_TRUE;
+            pipeline->depthWriteEnable = VK_TRUE;
+
+            // the topology set when recording has to be of the same class (points, lines, triangles, patches)
+            switch (pipeline->topology)
+            {
+            case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+                break;
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+                pipeline->topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+                break;
+            case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+                break;
+            default:
+                pipeline->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                break;
+            }
+        }
+
+        if (device.dynamicRasterizationSamples)
+            attachments->sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+        if (device.dynamicColorBlend)
+            pipeline->blendMode = VK_BLEND_FACTOR_ZERO;
+    }
+
+    static bool operator==(const AttachmentFormats &a, const AttachmentFormats &b)
+    {
+        return a.colorFormat == b.colorFormat && a.depthFormat == b.depthFormat && a.sampleCount == b.sampleCount;
+    }
+
+    // render pass with the same attachment layout as the ones built by createRenderPass()/createPostRenderPass() - load/store ops and image layouts don't affect compatibility
+    static VkRenderPass compatibleRenderPass(const Device &device, const AttachmentFormats &attachments)
+    {
+        for (const auto &rp : device.compatibleRenderPasses)
+        {
+            if (rp.first == attachments)
+                return rp.second;
+        }
+
+        bool msaaEnabled = attachments.sampleCount != VK_SAMPLE_COUNT_1_BIT;
+        bool depthEnabled = attachments.depthFormat != VK_FORMAT_UNDEFINED;
+
+        VkAttachmentDescription attachmentDescs[3] = { {}, {}, {} };
+        attachmentDescs[0].format = attachments.colorFormat;
+        attachmentDescs[0].samples = attachments.sampleCount;
+        attachmentDescs[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachmentDescs[1].format = attachments.depthFormat;
+        attachmentDescs[1].samples = attachments.sampleCount;
+        attachmentDescs[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachmentDescs[2].format = attachments.colorFormat;
+        attachmentDescs[2].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachmentDescs[2].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        for (VkAttachmentDescription &desc : attachmentDescs)
+        {
+            desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+
+        VkAttachmentReference colorAttachmentRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthAttachmentRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference resolveAttachmentRef = { depthEnabled ? 2u : 1u, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+        // without depth, the resolve target takes the depth attachment's slot
+        if (!depthEnabled)
+            attachmentDescs[1] = attachmentDescs[2];
+
+        VkSubpassDescription subpassDesc = {};
+        subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDesc.colorAttachmentCount = 1;
+        subpassDesc.pColorAttachments = &colorAttachmentRef;
+        subpassDesc.pDepthStencilAttachment = depthEnabled ? &depthAttachmentRef : nullptr;
+        subpassDesc.pResolveAttachments = msaaEnabled ? &resolveAttachmentRef : nullptr;
+
+        VkRenderPassCreateInfo rpCreateInfo = {};
+        rpCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        rpCreateInfo.attachmentCount = 1 + (depthEnabled ? 1 : 0) + (msaaEnabled ? 1 : 0);
+        rpCreateInfo.pAttachments = attachmentDescs;
+        rpCreateInfo.subpassCount = 1;
+        rpCreateInfo.pSubpasses = &subpassDesc;
+
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VK_VERIFY(vkCreateRenderPass(device.logical, &rpCreateInfo, nullptr, &renderPass));
+        device.compatibleRenderPasses.push_back(std::make_pair(attachments, renderPass));
+
+        return renderPass;
+    }
+
+    // create infos of one pipeline - they point into each other, so an instance must not move once filled in
+    struct GraphicsPipelineState
+    {
+        VkPipelineShaderStageCreateInfo ssCreateInfos[2];
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+        VkPipelineInputAssemblyStateCreateInfo iaCreateInfo;
+        VkViewport viewport;
+        VkRect2D scissor;
+        VkPipelineViewportStateCreateInfo vpCreateInfo;
+        VkPipelineRasterizationStateCreateInfo rCreateInfo;
+        VkPipelineMultisampleStateCreateInfo msCreateInfo;
+        VkPipelineDepthStencilStateCreateInfo dCreateInfo;
+        VkPipelineColorBlendAttachmentState cbaState;
+        VkPipelineColorBlendStateCreateInfo cbsCreateInfo;
+        VkDynamicState dynamicStates[11];
+        VkPipelineDynamicStateCreateInfo dsCreateInfo;
+        VkPipelineRenderingCreateInfoKHR renderingCreateInfo;
+        VkPipeline libraries[PIPELINE_PART_COUNT];
+        VkPipelineLibraryCreateInfoKHR libraryInfo;
+    };
+
+    static VkGraphicsPipelineCreateInfo fillPipelineState(const Device &device, const PipelineBuild &build, GraphicsPipelineState *state)
+    {
+        const Pipeline &pipeline = build.pipeline;
+
+        VkPipelineShaderStageCreateInfo &vssCreateInfo = state->ssCreateInfos[0];
+        vssCreateInfo = {};
         vssCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vssCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vssCreateInfo.module = shader.vertShader;
+        vssCreateInfo.module = build.vertShader;
         vssCreateInfo.pName = "main";
-        VkPipelineShaderStageCreateInfo fssCreateInfo = {};
+        VkPipelineShaderStageCreateInfo &fssCreateInfo = state->ssCreateInfos[1];
+        fssCreateInfo = {};
         fssCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fssCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fssCreateInfo.module = shader.fragShader;
+        fssCreateInfo.module = build.fragShader;
         fssCreateInfo.pName = "main";
 
-        VkPipelineShaderStageCreateInfo ssCreateInfos[] = { vssCreateInfo, fssCreateInfo };
-
         // fixed functions setup
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        VkPipelineVertexInputStateCreateInfo &vertexInputInfo = state->vertexInputInfo;
+        vertexInputInfo = {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = vbInfo ? (uint32_t)vbInfo->bindingDescriptions.size() : 0;
-        vertexInputInfo.pVertexBindingDescriptions = vbInfo ? vbInfo->bindingDescriptions.data() : nullptr;
-        vertexInputInfo.vertexAttributeDescriptionCount = vbInfo ? (uint32_t)vbInfo->attributeDescriptions.size() : 0;
-        vertexInputInfo.pVertexAttributeDescriptions = vbInfo ? vbInfo->attributeDescriptions.data() : nullptr;
+        if (build.hasVertexInput)
+        {
+            vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)build.vbInfo.bindingDescriptions.size();
+            vertexInputInfo.pVertexBindingDescriptions = build.vbInfo.bindingDescriptions.data();
+            vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)build.vbInfo.attributeDescriptions.size();
+            vertexInputInfo.pVertexAttributeDescriptions = build.vbInfo.attributeDescriptions.data();
+        }
 
-        VkPipelineInputAssemblyStateCreateInfo iaCreateInfo = {};
+        VkPipelineInputAssemblyStateCreateInfo &iaCreateInfo = state->iaCreateInfo;
+        iaCreateInfo = {};
         iaCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        iaCreateInfo.topology = pipeline->topology;
+        iaCreateInfo.topology = pipeline.topology;
         iaCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport = {};
+        VkViewport &viewport = state->viewport;
+        viewport = {};
         viewport.x = 0.f;
         viewport.y = 0.f;
-        viewport.width = (float)swapChain.extent.width;
-        viewport.height = (float)swapChain.extent.height;
+        viewport.width = (float)build.extent.width;
+        viewport.height = (float)build.extent.height;
         viewport.minDepth = 0.f;
         viewport.maxDepth = 1.f;
 
-        VkRect2D scissor = {};
+        VkRect2D &scissor = state->scissor;
+        scissor = {};
         scissor.offset.x = 0;
         scissor.offset.y = 0;
-        scissor.extent = swapChain.extent;
+        scissor.extent = build.extent;
 
-        VkPipelineViewportStateCreateInfo vpCreateInfo = {};
+        VkPipelineViewportStateCreateInfo &vpCreateInfo = state->vpCreateInfo;
+        vpCreateInfo = {};
         vpCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         vpCreateInfo.viewportCount = 1;
         vpCreateInfo.pViewports = &viewport;
         vpCreateInfo.scissorCount = 1;
         vpCreateInfo.pScissors = &scissor;
 
-        VkPipelineRasterizationStateCreateInfo rCreateInfo = {};
+        VkPipelineRasterizationStateCreateInfo &rCreateInfo = state->rCreateInfo;
+        rCreateInfo = {};
         rCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rCreateInfo.depthClampEnable = VK_FALSE;
         rCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-        rCreateInfo.polygonMode = pipeline->mode;
+        rCreateInfo.polygonMode = pipeline.mode;
         rCreateInfo.lineWidth = 1.f;
-        rCreateInfo.cullMode = pipeline->cullMode;
+        rCreateInfo.cullMode = pipeline.cullMode;
         rCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
         rCreateInfo.depthBiasEnable = VK_FALSE;
         rCreateInfo.depthBiasClamp = 0.f;
         rCreateInfo.depthBiasConstantFactor = 0.f;
         rCreateInfo.depthBiasSlopeFactor = 0.f;
 
-        VkPipelineMultisampleStateCreateInfo  msCreateInfo = {};
+        VkPipelineMultisampleStateCreateInfo &msCreateInfo = state->msCreateInfo;
+        msCreateInfo = {};
         msCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        msCreateInfo.sampleShadingEnable = pipeline->minSampleShading < 0.f? VK_FALSE: VK_TRUE;
-        msCreateInfo.rasterizationSamples = renderPass.sampleCount;
-        msCreateInfo.minSampleShading = pipeline->minSampleShading < 0.f ? 1.f : pipeline->minSampleShading;
+        msCreateInfo.sampleShadingEnable = pipeline.minSampleShading < 0.f? VK_FALSE: VK_TRUE;
+        msCreateInfo.rasterizationSamples = build.attachments.sampleCount;
+        msCreateInfo.minSampleShading = pipeline.minSampleShading < 0.f ? 1.f : pipeline.minSampleShading;
         msCreateInfo.pSampleMask = nullptr;
         msCreateInfo.alphaToCoverageEnable = VK_FALSE;
         msCreateInfo.alphaToOneEnable = VK_FALSE;
 
-        VkPipelineDepthStencilStateCreateInfo dCreateInfo = {};
+        VkPipelineDepthStencilStateCreateInfo &dCreateInfo = state->dCreateInfo;
+        dCreateInfo = {};
         dCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        dCreateInfo.depthTestEnable = pipeline->depthTestEnable;
-        dCreateInfo.depthWriteEnable = VK_TRUE;
+        dCreateInfo.depthTestEnable = pipeline.depthTestEnable;
+        dCreateInfo.depthWriteEnable = pipeline.depthWriteEnable;
         dCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
         dCreateInfo.depthBoundsTestEnable = VK_FALSE;
         dCreateInfo.minDepthBounds = 0.f;
@@ -145,17 +420,19 @@ namespace vk
         dCreateInfo.front = {};
         dCreateInfo.back = {};
 
-        VkPipelineColorBlendAttachmentState cbaState = {};
+        VkPipelineColorBlendAttachmentState &cbaState = state->cbaState;
+        cbaState = {};
         cbaState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        cbaState.blendEnable = pipeline->blendMode != VK_BLEND_FACTOR_ZERO ? VK_TRUE : VK_FALSE;
+        cbaState.blendEnable = pipeline.blendMode != VK_BLEND_FACTOR_ZERO ? VK_TRUE : VK_FALSE;
         cbaState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
         cbaState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
         cbaState.alphaBlendOp = VK_BLEND_OP_ADD;
         cbaState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        cbaState.dstColorBlendFactor = pipeline->blendMode;
+        cbaState.dstColorBlendFactor = pipeline.blendMode;
         cbaState.colorBlendOp = VK_BLEND_OP_ADD;
 
-        VkPipelineColorBlendStateCreateInfo cbsCreateInfo = {};
+        VkPipelineColorBlendStateCreateInfo &cbsCreateInfo = state->cbsCreateInfo;
+        cbsCreateInfo = {};
         cbsCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
         cbsCreateInfo.logicOpEnable = VK_FALSE;
         cbsCreateInfo.logicOp = VK_LOGIC_OP_COPY;
@@ -166,36 +443,46 @@ namespace vk
         cbsCreateInfo.blendConstants[2] = 0.f;
         cbsCreateInfo.blendConstants[3] = 0.f;
 
-        VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-
-        VkPipelineDynamicStateCreateInfo dsCreateInfo = {};
-        dsCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dsCreateInfo.dynamicStateCount = 2;
-        dsCreateInfo.pDynamicStates = dynamicStates;
-
-        VkPipelineLayoutCreateInfo plCreateInfo = {};
-        plCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        plCreateInfo.setLayoutCount = 1;
-        plCreateInfo.pSetLayouts = &descriptorLayout;
-        plCreateInfo.pushConstantRangeCount = pipeline->pushConstantRangeCount;
-        if (pipeline->pushConstantRangeCount > 0)
+        uint32_t dynamicStateCount = 0;
+        state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_VIEWPORT;
+        state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_SCISSOR;
+        if (device.extendedDynamicState)
         {
-            plCreateInfo.pPushConstantRanges = &pipeline->pushConstantRange;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
         }
-        else
+        if (device.dynamicRasterizationSamples)
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT;
+        if (device.dynamicColorBlend)
         {
-            plCreateInfo.pPushConstantRanges = nullptr;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+            state->dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
         }
 
-        VkResult plResult = vkCreatePipelineLayout(device.logical, &plCreateInfo, nullptr, &pipeline->layout);
-        if (plResult != VK_SUCCESS)
-            return plResult;
+        VkPipelineDynamicStateCreateInfo &dsCreateInfo = state->dsCreateInfo;
+        dsCreateInfo = {};
+        dsCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dsCreateInfo.dynamicStateCount = dynamicStateCount;
+        dsCreateInfo.pDynamicStates = state->dynamicStates;
+
+        // dynamic rendering: attachment formats are given directly
+        VkPipelineRenderingCreateInfoKHR &renderingCreateInfo = state->renderingCreateInfo;
+        renderingCreateInfo = {};
+        renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        renderingCreateInfo.colorAttachmentCount = 1;
+        renderingCreateInfo.pColorAttachmentFormats = &build.attachments.colorFormat;
+        renderingCreateInfo.depthAttachmentFormat = build.attachments.depthFormat;
 
         // create THE pipeline
         VkGraphicsPipelineCreateInfo pCreateInfo = {};
         pCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pCreateInfo.pNext = device.dynamicRendering ? &renderingCreateInfo : nullptr;
         pCreateInfo.stageCount = 2;
-        pCreateInfo.pStages = ssCreateInfos;
+        pCreateInfo.pStages = state->ssCreateInfos;
         pCreateInfo.pVertexInputState = &vertexInputInfo;
         pCreateInfo.pInputAssemblyState = &iaCreateInfo;
         pCreateInfo.pViewportState = &vpCreateInfo;
@@ -204,28 +491,360 @@ namespace vk
         pCreateInfo.pDepthStencilState = &dCreateInfo;
         pCreateInfo.pColorBlendState = &cbsCreateInfo;
         pCreateInfo.pDynamicState = &dsCreateInfo;
-        pCreateInfo.layout = pipeline->layout;
-        pCreateInfo.flags = pipeline->flags;
-        pCreateInfo.renderPass = renderPass.renderPass;
+        pCreateInfo.layout = pipeline.layout;
+        pCreateInfo.flags = pipeline.flags;
+        pCreateInfo.renderPass = build.renderPass;
         pCreateInfo.subpass = 0;
-        pCreateInfo.basePipelineHandle = pipeline->basePipelineHandle;
+        pCreateInfo.basePipelineHandle = pipeline.basePipelineHandle;
         pCreateInfo.basePipelineIndex = -1;
 
-        VkResult pResult = vkCreateGraphicsPipelines(device.logical, pipeline->cache, 1, &pCreateInfo, nullptr, &pipeline->pipeline);
-        vkDestroyShaderModule(device.logical, shader.vertShader, nullptr);
-        vkDestroyShaderModule(device.logical, shader.fragShader, nullptr);
+        return pCreateInfo;
+    }
+
+    // one part of the pipeline, taken from its complete create info - parts are built once and shared by all pipelines with the same state for them
+    static VkPipeline pipelineLibrary(const Device &device, const PipelineBuild &build, const VkGraphicsPipelineCreateInfo &pipelineInfo, PipelinePart part)
+    {
+        PipelineCache &cache = *build.pipeline.cache;
+        {
+            std::lock_guard<std::mutex> lock(cache.libraryMutex);
+            auto it = cache.libraries.find(build.partHashes[part]);
+            if (it != cache.libraries.end())
+                return it->second;
+        }
+
+        // attachment formats (dynamic rendering) are chained behind
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo = {};
+        libraryCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryCreateInfo.pNext = pipelineInfo.pNext;
+        libraryCreateInfo.flags = PIPELINE_PART_FLAGS[part];
+
+        VkGraphicsPipelineCreateInfo pCreateInfo = {};
+        pCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pCreateInfo.pNext = &libraryCreateInfo;
+        // optimized links need the parts' intermediate representation
+        pCreateInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+        pCreateInfo.subpass = 0;
+        pCreateInfo.basePipelineIndex = -1;
+        // each part picks the dynamic states belonging to it
+        pCreateInfo.pDynamicState = pipelineInfo.pDynamicState;
+
+        switch (part)
+        {
+        case VERTEX_INPUT:
+            pCreateInfo.pVertexInputState = pipelineInfo.pVertexInputState;
+            pCreateInfo.pInputAssemblyState = pipelineInfo.pInputAssemblyState;
+            break;
+        case PRE_RASTERIZATION:
+            pCreateInfo.stageCount = 1;
+            pCreateInfo.pStages = &pipelineInfo.pStages[0];
+            pCreateInfo.pViewportState = pipelineInfo.pViewportState;
+            pCreateInfo.pRasterizationState = pipelineInfo.pRasterizationState;
+            pCreateInfo.layout = pipelineInfo.layout;
+            pCreateInfo.renderPass = pipelineInfo.renderPass;
+            break;
+        case FRAGMENT_SHADER:
+            pCreateInfo.stageCount = 1;
+            pCreateInfo.pStages = &pipelineInfo.pStages[1];
+            pCreateInfo.pDepthStencilState = pipelineInfo.pDepthStencilState;
+            pCreateInfo.pMultisampleState = pipelineInfo.pMultisampleState;
+            pCreateInfo.layout = pipelineInfo.layout;
+            pCreateInfo.renderPass = pipelineInfo.renderPass;
+            break;
+        case FRAGMENT_OUTPUT:
+            pCreateInfo.pColorBlendState = pipelineInfo.pColorBlendState;
+            pCreateInfo.pMultisampleState = pipelineInfo.pMultisampleState;
+            pCreateInfo.renderPass = pipelineInfo.renderPass;
+            break;
+        default:
+            break;
+        }
+
+        VkPipeline library = VK_NULL_HANDLE;
+        if (vkCreateGraphicsPipelines(device.logical, build.driverCache, 1, &pCreateInfo, nullptr, &library) != VK_SUCCESS)
+            return VK_NULL_HANDLE;
 
-        return pResult;
+        // another thread may have built the same part in the meantime
+        std::lock_guard<std::mutex> lock(cache.libraryMutex);
+        auto inserted = cache.libraries.insert(std::make_pair(build.partHashes[part], library));
+        if (!inserted.second)
+            vkDestroyPipeline(device.logical, library, nullptr);
+
+        return inserted.first->second;
+    }
+
+    // create info linking the pipeline from its parts - false if a part couldn't be built
+    static bool linkPipelineState(const Device &device, const PipelineBuild &build, const VkGraphicsPipelineCreateInfo &pipelineInfo, GraphicsPipelineState *state, VkGraphicsPipelineCreateInfo *linkInfo)
+    {
+        for (int part = 0; part < PIPELINE_PART_COUNT; ++part)
+        {
+            state->libraries[part] = pipelineLibrary(device, build, pipelineInfo, (PipelinePart)part);
+            if (state->libraries[part] == VK_NULL_HANDLE)
+                return false;
+        }
+
+        state->libraryInfo = {};
+        state->libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+        state->libraryInfo.libraryCount = PIPELINE_PART_COUNT;
+        state->libraryInfo.pLibraries = state->libraries;
+
+        *linkInfo = {};
+        linkInfo->sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        linkInfo->pNext = &state->libraryInfo;
+        linkInfo->flags = pipelineInfo.flags;
+        if (build.linkOptimized)
+            linkInfo->flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+        linkInfo->layout = pipelineInfo.layout;
+        linkInfo->basePipelineHandle = pipelineInfo.basePipelineHandle;
+        linkInfo->basePipelineIndex = -1;
+
+        return true;
+    }
+
+    VkResult createPipeline(const Device &device, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, Pipeline *pipeline, const char **shaders)
+    {
+        PipelineBuild build;
+        PipelineBuild *builds[] = { &build };
+
+        // the caller waits either way - a single optimized link instead of a fast one followed by another
+        if (preparePipelineBuild(device, swapChain, attachments, descriptorLayout, vbInfo, *pipeline, shaders, &build))
+        {
+            build.linkOptimized = true;
+            buildPipelines(device, builds, 1);
+        }
+
+        return finishPipelineBuild(device, build, pipeline);
+    }
+
+    bool preparePipelineBuild(const Device &device, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, const Pipeline &pipeline, const char **shaders, PipelineBuild *build)
+    {
+        build->pipeline = pipeline;
+        build->attachments = attachments;
+        build->extent = swapChain.extent;
+        removeDynamicState(device, &build->pipeline, &build->attachments);
+        build->driverCache = pipeline.cache ? pipeline.cache->driverCache : VK_NULL_HANDLE;
+
+        if (pipeline.cache)
+        {
+            const PipelineCache::CachedShader *vs = cachedShader(device, *pipeline.cache, shaders[0]);
+            const PipelineCache::CachedShader *fs = cachedShader(device, *pipeline.cache, shaders[1]);
+            if (!vs || !fs)
+            {
+                build->result = VK_ERROR_INITIALIZATION_FAILED;
+                return false;
+            }
+
+            build->stateHash = pipelineStateHash(build->pipeline, build->attachments, descriptorLayout, vbInfo, vs->contentHash, fs->contentHash);
+
+            auto it = pipeline.cache->pipelines.find(build->stateHash);
+            if (it != pipeline.cache->pipelines.end())
+            {
+                build->pipeline.pipeline = it->second.pipeline;
+                build->pipeline.layout = it->second.layout;
+                build->cached = true;
+                build->result = VK_SUCCESS;
+                return false;
+            }
+
+            build->vertShader = vs->module;
+            build->fragShader = fs->module;
+
+            // parts are cached alongside complete pipelines, so there are no libraries without a cache
+            build->useLibraries = device.graphicsPipelineLibrary;
+            if (build->useLibraries)
+                pipelinePartHashes(device, build->pipeline, build->attachments, descriptorLayout, vbInfo, vs->contentHash, fs->contentHash, build->partHashes);
+        }
+        else
+        {
+            ShaderProgram shader = loadShader(device, shaders[0], shaders[1]);
+            build->vertShader = shader.vertShader;
+            build->fragShader = shader.fragShader;
+        }
+
+        if (vbInfo)
+        {
+            build->vbInfo = *vbInfo;
+            build->hasVertexInput = true;
+        }
+
+        VkPipelineLayoutCreateInfo plCreateInfo = {};
+        plCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        plCreateInfo.setLayoutCount = 1;
+        plCreateInfo.pSetLayouts = &descriptorLayout;
+        plCreateInfo.pushConstantRangeCount = pipeline.pushConstantRangeCount;
+        if (pipeline.pushConstantRangeCount > 0)
+        {
+            plCreateInfo.pPushConstantRanges = &pipeline.pushConstantRange;
+        }
+        else
+        {
+            plCreateInfo.pPushConstantRanges = nullptr;
+        }
+
+        build->result = vkCreatePipelineLayout(device.logical, &plCreateInfo, nullptr, &build->pipeline.layout);
+        if (build->result != VK_SUCCESS)
+            return false;
+
+        build->renderPass = device.dynamicRendering ? VK_NULL_HANDLE : compatibleRenderPass(device, build->attachments);
+        build->result = VK_NOT_READY;
+        return true;
+    }
+
+    void buildPipelines(const Device &device, PipelineBuild **builds, uint32_t count)
+    {
+        std::vector<GraphicsPipelineState> states(count);
+        std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+        std::vector<PipelineBuild *> created;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            VkGraphicsPipelineCreateInfo pipelineInfo = fillPipelineState(device, *builds[i], &states[i]);
+
+            // with libraries, the parts are built (or found) first and the pipeline itself is only linked from them
+            VkGraphicsPipelineCreateInfo linkInfo;
+            if (builds[i]->useLibraries)
+            {
+                if (!linkPipelineState(device, *builds[i], pipelineInfo, &states[i], &linkInfo))
+                {
+                    builds[i]->pipeline.pipeline = VK_NULL_HANDLE;
+                    builds[i]->result = VK_ERROR_INITIALIZATION_FAILED;
+                    continue;
+                }
+
+                pipelineInfo = linkInfo;
+            }
+
+            createInfos.push_back(pipelineInfo);
+            created.push_back(builds[i]);
+        }
+
+        std::vector<VkPipeline> pipelines(created.size(), VK_NULL_HANDLE);
+
+        for (size_t first = 0; first < created.size();)
+        {
+            VkPipelineCache driverCache = created[first]->driverCache;
+            size_t last = first + 1;
+            while (last < created.size() && created[last]->driverCache == driverCache)
+                ++last;
+
+            // pipelines that failed are left null, the others are valid even if the call as a whole failed
+            VkResult result = vkCreateGraphicsPipelines(device.logical, driverCache, (uint32_t)(last - first), &createInfos[first], nullptr, &pipelines[first]);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                created[i]->pipeline.pipeline = pipelines[i];
+                if (pipelines[i] != VK_NULL_HANDLE)
+                    created[i]->result = VK_SUCCESS;
+                else
+                    created[i]->result = result != VK_SUCCESS ? result : VK_ERROR_INITIALIZATION_FAILED;
+            }
+
+            first = last;
+        }
+    }
+
+    VkResult finishPipelineBuild(const Device &device, PipelineBuild &build, Pipeline *pipeline)
+    {
+        PipelineCache *cache = build.pipeline.cache;
+        bool optimized = !build.useLibraries || build.linkOptimized;
+
+        if (!cache)
+        {
+            if (build.vertShader != VK_NULL_HANDLE)
+                vkDestroyShaderModule(device.logical, build.vertShader, nullptr);
+            if (build.fragShader != VK_NULL_HANDLE)
+                vkDestroyShaderModule(device.logical, build.fragShader, nullptr);
+        }
+        else if (build.result == VK_SUCCESS && !build.cached)
+        {
+            auto it = cache->pipelines.find(build.stateHash);
+            if (it == cache->pipelines.end())
+            {
+                cache->pipelines[build.stateHash] = { build.pipeline.pipeline, build.pipeline.layout, optimized };
+            }
+            else if (optimized && !it->second.optimized)
+            {
+                // optimized version of a fast-linked pipeline - the old one may still be in use
+                build.replaced = it->second.pipeline;
+                it->second.pipeline = build.pipeline.pipeline;
+                it->second.optimized = true;
+                if (build.pipeline.layout != it->second.layout)
+                    vkDestroyPipelineLayout(device.logical, build.pipeline.layout, nullptr);
+                build.pipeline.layout = it->second.layout;
+            }
+            else
+            {
+                // the same state was built elsewhere in the meantime - keep the one already handed out
+                vkDestroyPipeline(device.logical, build.pipeline.pipeline, nullptr);
+                if (build.pipeline.layout != it->second.layout)
+                    vkDestroyPipelineLayout(device.logical, build.pipeline.layout, nullptr);
+                build.pipeline.pipeline = it->second.pipeline;
+                build.pipeline.layout = it->second.layout;
+            }
+        }
+
+        // the caller won't destroy anything that came from a cache (a relink's layout belongs to the cached pipeline)
+        if (build.result != VK_SUCCESS && !build.relink && build.pipeline.layout != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineLayout(device.logical, build.pipeline.layout, nullptr);
+            build.pipeline.layout = VK_NULL_HANDLE;
+        }
+
+        // build.pipeline has the dynamic state removed - the caller's copy keeps it for bindPipeline()
+        pipeline->pipeline = build.pipeline.pipeline;
+        pipeline->layout = build.pipeline.layout;
+        return build.result;
     }
 
     void destroyPipeline(const Device &device, Pipeline &pipeline)
     {
+        if (pipeline.cache)
+        {
+            pipeline.pipeline = VK_NULL_HANDLE;
+            pipeline.layout = VK_NULL_HANDLE;
+            return;
+        }
+
         if (pipeline.layout != VK_NULL_HANDLE)
             vkDestroyPipelineLayout(device.logical, pipeline.layout, nullptr);
         if (pipeline.pipeline != VK_NULL_HANDLE)
             vkDestroyPipeline(device.logical, pipeline.pipeline, nullptr);
     }
 
+    void bindPipeline(const Device &device, VkCommandBuffer cmdBuffer, const Pipeline &pipeline, VkSampleCountFlagBits sampleCount)
+    {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+
+        if (device.extendedDynamicState)
+        {
+            device.cmdSetCullMode(cmdBuffer, pipeline.cullMode);
+            device.cmdSetFrontFace(cmdBuffer, VK_FRONT_FACE_CLOCKWISE);
+            device.cmdSetPrimitiveTopology(cmdBuffer, pipeline.topology);
+            device.cmdSetDepthTestEnable(cmdBuffer, pipeline.depthTestEnable);
+            device.cmdSetDepthWriteEnable(cmdBuffer, pipeline.depthWriteEnable);
+            device.cmdSetDepthCompareOp(cmdBuffer, VK_COMPARE_OP_LESS);
+        }
+
+        if (device.dynamicRasterizationSamples)
+            device.cmdSetRasterizationSamples(cmdBuffer, sampleCount);
+
+        // same blend setup fillPipelineState() bakes in otherwise
+        if (device.dynamicColorBlend)
+        {
+            VkBool32 blendEnable = pipeline.blendMode != VK_BLEND_FACTOR_ZERO ? VK_TRUE : VK_FALSE;
+
+            VkColorBlendEquationEXT blendEquation = {};
+            blendEquation.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            blendEquation.dstColorBlendFactor = pipeline.blendMode;
+            blendEquation.colorBlendOp = VK_BLEND_OP_ADD;
+            blendEquation.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blendEquation.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            blendEquation.alphaBlendOp = VK_BLEND_OP_ADD;
+
+            device.cmdSetColorBlendEnable(cmdBuffer, 0, 1, &blendEnable);
+            device.cmdSetColorBlendEquation(cmdBuffer, 0, 1, &blendEquation);
+        }
+    }
+
     VkResult createRenderPass(const Device &device, const SwapChain &swapChain, RenderPass *renderPass)
     {
         bool msaaEnabled = renderPass->sampleCount != VK_SAMPLE_COUNT_1_BIT;
@@ -242,6 +861,8 @@ namespace vk
         // treat this attachment as an interim color stage if MSAA is enabled
         if (msaaEnabled)
             colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        else if (renderPass->offscreen)
+            colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         else
             colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
@@ -296,17 +917,73 @@ namespace vk
         rpCreateInfo.pSubpasses = &subpassDesc;
 
         // subpass depencency: wait for color stage
+        VkSubpassDependency spDeps[2] = { {}, {} };
+        spDeps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        spDeps[0].dstSubpass = 0;
+        spDeps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        spDeps[0].srcAccessMask = 0;
+        spDeps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        spDeps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        // offscreen target: previous frame's post pass must be done sampling it, this frame's post pass waits for the writes
+        if (renderPass->offscreen && !msaaEnabled)
+        {
+            spDeps[0].srcStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+            spDeps[1].srcSubpass = 0;
+            spDeps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+            spDeps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            spDeps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            spDeps[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            spDeps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+
+        rpCreateInfo.dependencyCount = (renderPass->offscreen && !msaaEnabled) ? 2 : 1;
+        rpCreateInfo.pDependencies = spDeps;
+
+        return vkCreateRenderPass(device.logical, &rpCreateInfo, nullptr, &renderPass->renderPass);
+    }
+
+    VkResult createPostRenderPass(const Device &device, const SwapChain &swapChain, RenderPass *renderPass)
+    {
+        // every pixel is overwritten, so previous contents are irrelevant
+        VkAttachmentDescription colorAttachmentDesc = {};
+        colorAttachmentDesc.format = swapChain.format;
+        colorAttachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkAttachmentReference colorAttachmentRef = {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpassDesc = {};
+        subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDesc.colorAttachmentCount = 1;
+        subpassDesc.pColorAttachments = &colorAttachmentRef;
+
         VkSubpassDependency spDep = {};
         spDep.srcSubpass = VK_SUBPASS_EXTERNAL;
         spDep.dstSubpass = 0;
         spDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         spDep.srcAccessMask = 0;
         spDep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        spDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        spDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+        VkRenderPassCreateInfo rpCreateInfo = {};
+        rpCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        rpCreateInfo.attachmentCount = 1;
+        rpCreateInfo.pAttachments = &colorAttachmentDesc;
+        rpCreateInfo.subpassCount = 1;
+        rpCreateInfo.pSubpasses = &subpassDesc;
         rpCreateInfo.dependencyCount = 1;
         rpCreateInfo.pDependencies = &spDep;
 
+        renderPass->sampleCount = VK_SAMPLE_COUNT_1_BIT;
         return vkCreateRenderPass(device.logical, &rpCreateInfo, nullptr, &renderPass->renderPass);
     }
 
@@ -8,12 +8,14 @@
 
 namespace vk
 {
+    struct PipelineCache;
+
     struct Pipeline
     {
         VkPipelineLayout layout = VK_NULL_HANDLE;
         VkPipeline pipeline = VK_NULL_HANDLE;
         VkPipeline basePipelineHandle = VK_NULL_HANDLE;
-        VkPipelineCache cache = VK_NULL_HANDLE;
+        PipelineCache *cache = nullptr; // pipelines built through a cache are owned by it - destroying only resets the handles
         VkPipelineCreateFlags flags = 0;
         VkPushConstantRange pushConstantRange = {};
         uint32_t pushConstantRangeCount = 0;
@@ -22,6 +24,7 @@ namespace vk
         VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         VkBlendFactor blendMode = VK_BLEND_FACTOR_ZERO;
         VkBool32 depthTestEnable = VK_TRUE;
+        VkBool32 depthWriteEnable = VK_TRUE;
         float minSampleShading = -1.f; // sample shading minimum fraction - >= 0 to enable
     };
 
@@ -30,11 +33,50 @@ namespace vk
         VkRenderPass renderPass = VK_NULL_HANDLE;
         VkAttachmentLoadOp colorLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        bool offscreen = false; // single sampled color is read by a post-processing pass instead of being presented
+    };
+
+    // pipeline state resolved up front, so that the pipeline itself can be created on any thread
+    struct PipelineBuild
+    {
+        Pipeline pipeline;              // layout is created by preparePipelineBuild()
+        AttachmentFormats attachments;
+        VkExtent2D extent = { 0, 0 };
+        VertexBufferInfo vbInfo;
+        bool hasVertexInput = false;
+        VkShaderModule vertShader = VK_NULL_HANDLE;
+        VkShaderModule fragShader = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkPipelineCache driverCache = VK_NULL_HANDLE;
+        uint64_t stateHash = 0;
+        bool cached = false;            // found in the pipeline cache - nothing to build
+        // graphics pipeline library: link from cached parts (vertex input, pre-rasterization, fragment shader, fragment output)
+        bool useLibraries = false;
+        bool linkOptimized = false;     // link time optimization - slower to link, faster to run
+        bool relink = false;            // optimized link of a fast-linked pipeline already in the cache, which owns the layout
+        uint64_t partHashes[4] = {};
+        VkPipeline replaced = VK_NULL_HANDLE; // fast-linked pipeline the optimized link took the place of - the caller retires it
+        VkResult result = VK_NOT_READY;
     };
 
 
-    VkResult createPipeline(const Device &device, const SwapChain &swapChain, const RenderPass &renderPass, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, Pipeline *pipeline, const char **shaders);
+    // with extended dynamic state, cull mode, topology, depth, blend and sample count are left out of the created pipeline -
+    // pipelines differing only in those share one, bindPipeline() sets them when recording
+    // pipelines only depend on attachment formats - they can be used with any render pass (or dynamic rendering) that matches them
+    // (with a cache, building a pipeline from the same state again is a lookup)
+    VkResult createPipeline(const Device &device, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, Pipeline *pipeline, const char **shaders);
     void     destroyPipeline(const Device &device, Pipeline &pipeline);
+    // bind for drawing to attachments with sampleCount samples, along with pipeline's dynamic state
+    void     bindPipeline(const Device &device, VkCommandBuffer cmdBuffer, const Pipeline &pipeline, VkSampleCountFlagBits sampleCount);
+    // createPipeline() in steps: prepare and finish touch shared state (cache, shader modules, render passes) and belong on the render thread,
+    // buildPipelines() only calls vkCreateGraphicsPipelines - returns false if there's nothing to build (cache hit or failure)
+    bool     preparePipelineBuild(const Device &device, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, const Pipeline &pipeline, const char **shaders, PipelineBuild *build);
+    // consecutive builds sharing a driver cache are created in a single call
+    void     buildPipelines(const Device &device, PipelineBuild **builds, uint32_t count);
+    // sets the handles of pipeline and adds it to its cache - failed (or never built) builds release what preparation created
+    VkResult finishPipelineBuild(const Device &device, PipelineBuild &build, Pipeline *pipeline);
     VkResult createRenderPass(const Device &device, const SwapChain &swapChain, RenderPass *renderPass);
+    // color-only pass writing the swapchain image (fullscreen post-processing)
+    VkResult createPostRenderPass(const Device &device, const SwapChain &swapChain, RenderPass *renderPass);
     void     destroyRenderPass(const Device &device, RenderPass &renderPass);
 }
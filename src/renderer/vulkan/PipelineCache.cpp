@@ -0,0 +1,136 @@
+#include "renderer/vulkan/PipelineCache.hpp"
+#include "Utils.hpp"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vk
+{
+    // the driver keeps adding to the cache with every new pipeline - don't load or store anything larger than this
+    static const size_t MAX_PIPELINE_CACHE_SIZE = 64 * 1024 * 1024;
+    // VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID and cache UUID
+    static const size_t CACHE_HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+
+    static bool validCacheHeader(const Device &device, const std::vector<char> &data)
+    {
+        if (data.size() < CACHE_HEADER_SIZE)
+            return false;
+
+        // read field by field - the data is tightly packed, the struct doesn't have to be
+        uint32_t header[4];
+        memcpy(header, data.data(), sizeof(header));
+
+        if (header[0] < CACHE_HEADER_SIZE || header[0] > data.size())
+        {
+            LOG_MESSAGE("Pipeline cache: invalid header size " << header[0]);
+            return false;
+        }
+
+        // anything from another driver version or GPU would be rejected (or worse) by the driver
+        if (header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header[2] != device.properties.vendorID || header[3] != device.properties.deviceID ||
+            memcmp(data.data() + sizeof(header), device.properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            LOG_MESSAGE("Pipeline cache: data written by a different device or driver - starting empty");
+            return false;
+        }
+
+        return true;
+    }
+
+    static std::vector<char> readCacheFile(const char *path)
+    {
+        std::vector<char> data;
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open())
+            return data;
+
+        std::streamoff size = file.tellg();
+        if (size <= 0 || (size_t)size > MAX_PIPELINE_CACHE_SIZE)
+            return data;
+
+        data.resize((size_t)size);
+        file.seekg(0);
+        if (!file.read(data.data(), size))
+            data.clear();
+
+        return data;
+    }
+
+    VkResult createPipelineCache(const Device &device, const char *path, PipelineCache *cache)
+    {
+        std::vector<char> data;
+        if (path)
+            data = readCacheFile(path);
+
+        VkPipelineCacheCreateInfo pcInfo = {};
+        pcInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        if (validCacheHeader(device, data))
+        {
+            pcInfo.initialDataSize = data.size();
+            pcInfo.pInitialData = data.data();
+
+            if (vkCreatePipelineCache(device.logical, &pcInfo, nullptr, &cache->driverCache) == VK_SUCCESS)
+            {
+                LOG_MESSAGE("Pipeline cache: loaded " << data.size() << " bytes from " << path);
+                return VK_SUCCESS;
+            }
+
+            // header checks out but the driver still refused the data
+            pcInfo.initialDataSize = 0;
+            pcInfo.pInitialData = nullptr;
+        }
+
+        return vkCreatePipelineCache(device.logical, &pcInfo, nullptr, &cache->driverCache);
+    }
+
+    void destroyPipelineCache(const Device &device, PipelineCache &cache)
+    {
+        for (auto &p : cache.pipelines)
+        {
+            vkDestroyPipeline(device.logical, p.second.pipeline, nullptr);
+            vkDestroyPipelineLayout(device.logical, p.second.layout, nullptr);
+        }
+
+        for (auto &s : cache.shaders)
+            vkDestroyShaderModule(device.logical, s.second.module, nullptr);
+
+        for (auto &l : cache.libraries)
+            vkDestroyPipeline(device.logical, l.second, nullptr);
+
+        vkDestroyPipelineCache(device.logical, cache.driverCache, nullptr);
+        cache.pipelines.clear();
+        cache.shaders.clear();
+        cache.libraries.clear();
+        cache.driverCache = VK_NULL_HANDLE;
+    }
+
+    bool savePipelineCache(const Device &device, const PipelineCache &cache, const char *path)
+    {
+        size_t size = pipelineCacheSize(device, cache);
+
+        if (size == 0 || size > MAX_PIPELINE_CACHE_SIZE)
+        {
+            LOG_MESSAGE("Pipeline cache: not saving " << size << " bytes");
+            return false;
+        }
+
+        // may have grown since the size query - VK_INCOMPLETE then, and the next save picks it up
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device.logical, cache.driverCache, &size, data.data()) != VK_SUCCESS)
+            return false;
+
+        return WriteFileAtomic(path, data.data(), size);
+    }
+
+    size_t pipelineCacheSize(const Device &device, const PipelineCache &cache)
+    {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device.logical, cache.driverCache, &size, nullptr) != VK_SUCCESS)
+            return 0;
+
+        return size;
+    }
+}
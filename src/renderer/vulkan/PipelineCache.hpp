@@ -0,0 +1,49 @@
+#pragma once
+
+#include "renderer/vulkan/Device.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ *  Pipeline cache: complete pipelines and shader modules kept in memory, on top of the driver's cache persisted between runs
+ */
+
+namespace vk
+{
+    struct PipelineCache
+    {
+        struct CachedPipeline
+        {
+            VkPipeline pipeline;
+            VkPipelineLayout layout;
+            bool optimized; // false if fast-linked from pipeline libraries - replaced once the optimized link is done
+        };
+
+        struct CachedShader
+        {
+            VkShaderModule module;
+            uint64_t contentHash;
+        };
+
+        VkPipelineCache driverCache = VK_NULL_HANDLE;
+        // keyed by a hash of everything createPipeline() builds the pipeline from
+        std::unordered_map<uint64_t, CachedPipeline> pipelines;
+        // keyed by file path - pipelines refer to shaders by content hash
+        std::unordered_map<std::string, CachedShader> shaders;
+        // graphics pipeline library parts keyed by a hash of the state they're built from - shared between threads building pipelines
+        std::unordered_map<uint64_t, VkPipeline> libraries;
+        std::mutex libraryMutex;
+    };
+
+    // driver cache starts from the data stored at path if it was written for the same driver and device (path may be null) - empty otherwise
+    VkResult createPipelineCache(const Device &device, const char *path, PipelineCache *cache);
+    // destroys every cached pipeline and shader module as well - the device must be idle
+    void     destroyPipelineCache(const Device &device, PipelineCache &cache);
+    // written to a temporary file and moved over path, so an interrupted save never leaves a truncated cache behind
+    // (false if writing failed or the data exceeds the size limit)
+    bool     savePipelineCache(const Device &device, const PipelineCache &cache, const char *path);
+    // current size of the driver cache data in bytes
+    size_t   pipelineCacheSize(const Device &device, const PipelineCache &cache);
+}
@@ -0,0 +1,185 @@
+#include "renderer/vulkan/PipelineCompiler.hpp"
+#include "renderer/vulkan/PipelineCache.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+
+namespace vk
+{
+    // upper bound of requests a worker takes at once - larger batches let the driver share work, but keep other workers idle
+    static const size_t MAX_BATCH_SIZE = 8;
+
+    static void compilerThread(const Device *device, PipelineCompiler *compiler)
+    {
+        std::vector<std::shared_ptr<PipelineCompiler::Request>> batch;
+        std::vector<PipelineBuild *> builds;
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(compiler->mutex);
+                compiler->wakeUp.wait(lock, [compiler] { return compiler->quit || !compiler->queued.empty(); });
+                if (compiler->quit)
+                    return;
+
+                // split what's queued between the workers
+                size_t batchSize = std::max<size_t>(1, compiler->queued.size() / compiler->workers.size());
+                batchSize = std::min(batchSize, MAX_BATCH_SIZE);
+                while (!compiler->queued.empty() && batch.size() < batchSize)
+                {
+                    batch.push_back(compiler->queued.front());
+                    compiler->queued.pop_front();
+                }
+            }
+
+            for (auto &request : batch)
+                builds.push_back(&request->build);
+
+            buildPipelines(*device, builds.data(), (uint32_t)builds.size());
+
+            {
+                std::lock_guard<std::mutex> lock(compiler->mutex);
+                compiler->compiled.insert(compiler->compiled.end(), batch.begin(), batch.end());
+            }
+
+            batch.clear();
+            builds.clear();
+        }
+    }
+
+    static void queueRequest(PipelineCompiler &compiler, const PipelineHandle &request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(compiler.mutex);
+            compiler.queued.push_back(request);
+        }
+        compiler.wakeUp.notify_one();
+    }
+
+    static void publishRequest(const Device &device, PipelineCompiler::Request &request)
+    {
+        VkResult result = finishPipelineBuild(device, request.build, &request.pipeline);
+        LOG_MESSAGE_ASSERT(result == VK_SUCCESS, "Pipeline compilation failed: " << result);
+
+        request.ready = result == VK_SUCCESS;
+        request.failed = !request.ready;
+    }
+
+    void startPipelineCompiler(const Device &device, PipelineCompiler &compiler, int numThreads)
+    {
+        if (numThreads <= 0)
+            numThreads = std::min((int)std::thread::hardware_concurrency() - 1, 4);
+
+        // workers read the worker count when batching - held until all of them are started
+        std::lock_guard<std::mutex> lock(compiler.mutex);
+        compiler.quit = false;
+        for (int i = 0; i < numThreads; ++i)
+            compiler.workers.emplace_back(compilerThread, &device, &compiler);
+    }
+
+    void stopPipelineCompiler(const Device &device, PipelineCompiler &compiler)
+    {
+        {
+            std::lock_guard<std::mutex> lock(compiler.mutex);
+            compiler.quit = true;
+        }
+
+        compiler.wakeUp.notify_all();
+        for (std::thread &worker : compiler.workers)
+            worker.join();
+        compiler.workers.clear();
+
+        // publishing may queue optimized relinks, which are dropped along with everything else never built
+        updatePipelineCompiler(device, compiler);
+
+        // only their pipeline layouts need releasing - relinks use the cached pipeline's
+        for (auto &request : compiler.queued)
+        {
+            if (request->build.relink)
+                continue;
+
+            finishPipelineBuild(device, request->build, &request->pipeline);
+            request->failed = true;
+        }
+        compiler.queued.clear();
+        compiler.inFlight.clear();
+    }
+
+    PipelineHandle compilePipeline(const Device &device, PipelineCompiler &compiler, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, const Pipeline &pipeline, const char **shaders)
+    {
+        LOG_MESSAGE_ASSERT(pipeline.cache, "Background compiled pipelines are owned by a pipeline cache");
+
+        // the handle's copy keeps the state set when binding (dynamic state), the handles are filled in once built
+        PipelineHandle request = std::make_shared<PipelineCompiler::Request>();
+        request->pipeline = pipeline;
+
+        // cache hit or failed before there was anything to build
+        if (!preparePipelineBuild(device, swapChain, attachments, descriptorLayout, vbInfo, pipeline, shaders, &request->build))
+        {
+            publishRequest(device, *request);
+            return request;
+        }
+
+        auto it = compiler.inFlight.find(request->build.stateHash);
+        if (it != compiler.inFlight.end())
+        {
+            // releases the duplicate's pipeline layout
+            finishPipelineBuild(device, request->build, &request->pipeline);
+            return it->second;
+        }
+
+        if (compiler.workers.empty())
+        {
+            PipelineBuild *builds[] = { &request->build };
+            request->build.linkOptimized = true;
+            buildPipelines(device, builds, 1);
+            publishRequest(device, *request);
+            return request;
+        }
+
+        compiler.inFlight[request->build.stateHash] = request;
+        queueRequest(compiler, request);
+
+        return request;
+    }
+
+    void updatePipelineCompiler(const Device &device, PipelineCompiler &compiler)
+    {
+        std::vector<PipelineHandle> compiled;
+        {
+            std::lock_guard<std::mutex> lock(compiler.mutex);
+            compiled.swap(compiler.compiled);
+        }
+
+        // added to the cache here rather than on the workers, so the cache itself needs no locking
+        for (PipelineHandle &request : compiled)
+        {
+            // draws pick up the optimized pipeline from the next frame on - if relinking failed, the fast-linked one stays
+            if (request->build.relink)
+            {
+                Pipeline optimized = request->pipeline;
+                if (finishPipelineBuild(device, request->build, &optimized) == VK_SUCCESS)
+                    request->pipeline = optimized;
+                if (request->build.replaced != VK_NULL_HANDLE)
+                    compiler.retired.push_back(request->build.replaced);
+                continue;
+            }
+
+            publishRequest(device, *request);
+            compiler.inFlight.erase(request->build.stateHash);
+
+            // fast-linked from pipeline libraries: usable right away, the optimized link follows in the background
+            if (request->ready && request->build.useLibraries && !request->build.linkOptimized && !request->build.cached)
+            {
+                request->build.relink = true;
+                request->build.linkOptimized = true;
+                request->build.result = VK_NOT_READY;
+                queueRequest(compiler, request);
+            }
+        }
+    }
+
+    const Pipeline *readyPipeline(const PipelineHandle &handle)
+    {
+        return handle && handle->ready ? &handle->pipeline : nullptr;
+    }
+}
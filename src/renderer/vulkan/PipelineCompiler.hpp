@@ -0,0 +1,56 @@
+#pragma once
+
+#include "renderer/vulkan/Pipeline.hpp"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ *  Background pipeline compilation: worker threads create pipelines while the render thread keeps going -
+ *  draw sites check the returned handle and skip drawing until the pipeline is ready
+ */
+
+namespace vk
+{
+    struct PipelineCompiler
+    {
+        struct Request
+        {
+            PipelineBuild build;
+            Pipeline pipeline;   // state as requested, handles are valid once ready
+            bool ready = false;  // render thread only, set when the result is published
+            bool failed = false;
+        };
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        // guarded by mutex: prepared requests waiting for a worker and built ones waiting to be published
+        std::deque<std::shared_ptr<Request>> queued;
+        std::vector<std::shared_ptr<Request>> compiled;
+        bool quit = false;
+        // render thread only - the same state requested again while compiling shares the request
+        std::unordered_map<uint64_t, std::shared_ptr<Request>> inFlight;
+        // render thread only - fast-linked pipelines replaced by their optimized link, frames in flight may still use them
+        std::vector<VkPipeline> retired;
+    };
+
+    typedef std::shared_ptr<PipelineCompiler::Request> PipelineHandle;
+
+    // numThreads <= 0 leaves one core to the render thread, with no workers requests are compiled right away
+    void startPipelineCompiler(const Device &device, PipelineCompiler &compiler, int numThreads = 0);
+    // requests no worker has picked up yet are dropped - call before the pipeline cache is destroyed
+    void stopPipelineCompiler(const Device &device, PipelineCompiler &compiler);
+    // same arguments as createPipeline() - the pipeline needs a cache, which owns the result. Cache hits are ready right away,
+    // pipelines linked from libraries are fast-linked first and swapped for the optimized link once that's done
+    PipelineHandle compilePipeline(const Device &device, PipelineCompiler &compiler, const SwapChain &swapChain, const AttachmentFormats &attachments, const VkDescriptorSetLayout &descriptorLayout, const VertexBufferInfo *vbInfo, const Pipeline &pipeline, const char **shaders);
+    // publish pipelines the workers have finished - once per frame on the render thread. The caller takes over
+    // destroying the pipelines left in compiler.retired, once no frame in flight uses them anymore
+    void updatePipelineCompiler(const Device &device, PipelineCompiler &compiler);
+    // null while the pipeline is still compiling (or if it failed)
+    const Pipeline *readyPipeline(const PipelineHandle &handle);
+}
@@ -0,0 +1,406 @@
+#include "renderer/vulkan/RenderGraph.hpp"
+#include <algorithm>
+
+namespace vk
+{
+    static const VkAccessFlags WriteAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    struct AccessInfo
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageUsageFlags usage;
+    };
+
+    static AccessInfo accessInfo(RenderGraph::AccessType type)
+    {
+        switch (type)
+        {
+        case RenderGraph::COLOR_ATTACHMENT:
+            // read for blending
+            return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+        case RenderGraph::DEPTH_ATTACHMENT:
+            return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+        case RenderGraph::SAMPLED:
+        default:
+            return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT };
+        }
+    }
+
+    static VkImageAspectFlags imageAspect(const RenderGraph::Resource &resource)
+    {
+        if (resource.texture.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return getDepthStencilAspect(resource.format);
+
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+
+    static VkImageMemoryBarrier imageBarrier(const RenderGraph::Resource &resource, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+    {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.texture.image;
+        barrier.subresourceRange.aspectMask = imageAspect(resource);
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    uint32_t addTransientImage(RenderGraph &graph, const char *name, VkFormat format, const VkExtent2D &extent, VkSampleCountFlagBits sampleCount)
+    {
+        RenderGraph::Resource resource;
+        resource.name = name;
+        resource.imported = false;
+        resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.format = format;
+        resource.extent = extent;
+        resource.sampleCount = sampleCount;
+        graph.resources.push_back(resource);
+        return (uint32_t)graph.resources.size() - 1;
+    }
+
+    uint32_t addImportedImage(RenderGraph &graph, const char *name, VkImageLayout finalLayout)
+    {
+        RenderGraph::Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resource.finalLayout = finalLayout;
+        resource.format = VK_FORMAT_UNDEFINED;
+        resource.extent = { 0, 0 };
+        resource.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        graph.resources.push_back(resource);
+        return (uint32_t)graph.resources.size() - 1;
+    }
+
+    void setImportedImage(RenderGraph &graph, uint32_t resource, VkImage image, VkImageView imageView, VkFormat format)
+    {
+        RenderGraph::Resource &r = graph.resources[resource];
+        LOG_MESSAGE_ASSERT(r.imported, "Render graph image " << r.name << " is not imported!");
+
+        r.texture.image = image;
+        r.texture.imageView = imageView;
+        r.texture.format = format;
+        r.format = format;
+    }
+
+    uint32_t addPass(RenderGraph &graph, const char *name, std::function<void(VkCommandBuffer)> record)
+    {
+        RenderGraph::Pass pass;
+        pass.name = name;
+        pass.record = std::move(record);
+        graph.passes.push_back(std::move(pass));
+        return (uint32_t)graph.passes.size() - 1;
+    }
+
+    void addAccess(RenderGraph &graph, uint32_t pass, uint32_t resource, RenderGraph::AccessType type, VkImageLayout layoutAfter)
+    {
+        graph.passes[pass].accesses.push_back({ resource, type, layoutAfter });
+    }
+
+    VkResult compileRenderGraph(const Device &device, RenderGraph &graph)
+    {
+        // walk back from the imported images: a pass is live if something live reads what it writes
+        std::vector<bool> needed(graph.resources.size(), false);
+        for (size_t i = 0; i < graph.resources.size(); ++i)
+            needed[i] = graph.resources[i].imported;
+
+        for (size_t p = graph.passes.size(); p-- > 0;)
+        {
+            RenderGraph::Pass &pass = graph.passes[p];
+            pass.culled = true;
+
+            for (const RenderGraph::Access &a : pass.accesses)
+            {
+                if (a.type != RenderGraph::SAMPLED && needed[a.resource])
+                    pass.culled = false;
+            }
+
+            if (pass.culled)
+                continue;
+
+            for (const RenderGraph::Access &a : pass.accesses)
+            {
+                if (a.type == RenderGraph::SAMPLED)
+                    needed[a.resource] = true;
+            }
+        }
+
+        // lifetimes and usage of everything the live passes touch
+        for (size_t p = 0; p < graph.passes.size(); ++p)
+        {
+            if (graph.passes[p].culled)
+                continue;
+
+            for (const RenderGraph::Access &a : graph.passes[p].accesses)
+            {
+                RenderGraph::Resource &r = graph.resources[a.resource];
+                if (r.firstPass < 0)
+                    r.firstPass = (int)p;
+                r.lastPass = (int)p;
+                r.texture.usage |= accessInfo(a.type).usage;
+            }
+        }
+
+        // slots are reused by images whose lifetimes don't overlap
+        struct SlotInfo
+        {
+            VkMemoryRequirements requirements;
+            bool lazy;
+            std::vector<uint32_t> images;
+        };
+
+        std::vector<SlotInfo> slots;
+        uint32_t numImages = 0;
+
+        for (uint32_t i = 0; i < graph.resources.size(); ++i)
+        {
+            RenderGraph::Resource &r = graph.resources[i];
+            if (r.imported || r.firstPass < 0)
+                continue;
+
+            // never sampled: contents don't outlive the pass, so on-chip (lazily allocated) memory is enough
+            bool lazy = !(r.texture.usage & VK_IMAGE_USAGE_SAMPLED_BIT);
+            if (lazy)
+                r.texture.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+            r.texture.format = r.format;
+            r.texture.extent = r.extent;
+            r.texture.sampleCount = r.sampleCount;
+            r.texture.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            r.texture.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = { r.extent.width, r.extent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = r.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = r.texture.usage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.samples = r.sampleCount;
+
+            VkResult result = vkCreateImage(device.logical, &imageInfo, nullptr, &r.texture.image);
+            if (result != VK_SUCCESS)
+                return result;
+
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(device.logical, r.texture.image, &requirements);
+
+            for (size_t s = 0; s < slots.size() && r.memorySlot < 0; ++s)
+            {
+                SlotInfo &slot = slots[s];
+                if (slot.lazy != lazy || !(slot.requirements.memoryTypeBits & requirements.memoryTypeBits))
+                    continue;
+
+                bool overlaps = false;
+                for (uint32_t other : slot.images)
+                {
+                    const RenderGraph::Resource &o = graph.resources[other];
+                    overlaps |= o.firstPass <= r.lastPass && r.firstPass <= o.lastPass;
+                }
+
+                if (overlaps)
+                    continue;
+
+                slot.requirements.size = std::max(slot.requirements.size, requirements.size);
+                slot.requirements.alignment = std::max(slot.requirements.alignment, requirements.alignment);
+                slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+                slot.images.push_back(i);
+                r.memorySlot = (int)s;
+            }
+
+            if (r.memorySlot < 0)
+            {
+                slots.push_back({ requirements, lazy, { i } });
+                r.memorySlot = (int)slots.size() - 1;
+            }
+
+            numImages++;
+        }
+
+        graph.memory.resize(slots.size());
+        for (size_t s = 0; s < slots.size(); ++s)
+        {
+            VmaAllocationCreateInfo allocInfo = {};
+            allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+            // falls back to regular device local memory where lazy allocation isn't available
+            allocInfo.preferredFlags = slots[s].lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+
+            VkResult result = vmaAllocateMemory(device.allocator, &slots[s].requirements, &allocInfo, &graph.memory[s].allocation, nullptr);
+            if (result != VK_SUCCESS)
+                return result;
+
+            for (uint32_t i : slots[s].images)
+            {
+                RenderGraph::Resource &r = graph.resources[i];
+
+                result = vmaBindImageMemory(device.allocator, graph.memory[s].allocation, r.texture.image);
+                if (result != VK_SUCCESS)
+                    return result;
+
+                result = createImageView(device, r.texture.image, imageAspect(r), &r.texture.imageView, r.format, 1);
+                if (result != VK_SUCCESS)
+                    return result;
+
+                if (r.texture.usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+                {
+                    result = createTextureSampler(device, &r.texture);
+                    if (result != VK_SUCCESS)
+                        return result;
+                }
+            }
+        }
+
+        uint32_t numCulled = 0;
+        for (const RenderGraph::Pass &pass : graph.passes)
+            numCulled += pass.culled ? 1 : 0;
+
+        LOG_MESSAGE("Render graph: " << graph.passes.size() - numCulled << " passes (" << numCulled << " culled), "
+                    << numImages << " transient images in " << slots.size() << " memory blocks");
+
+        return VK_SUCCESS;
+    }
+
+    static void recordBarriers(RenderGraph &graph, size_t passIndex, VkCommandBuffer cmdBuffer)
+    {
+        std::vector<VkImageMemoryBarrier> barriers;
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+
+        for (const RenderGraph::Access &a : graph.passes[passIndex].accesses)
+        {
+            RenderGraph::Resource &r = graph.resources[a.resource];
+            RenderGraph::MemorySlot *slot = r.imported ? nullptr : &graph.memory[r.memorySlot];
+            AccessInfo info = accessInfo(a.type);
+
+            // first use in the frame: previous contents are discarded, but whatever used the memory last must be done with it
+            bool firstUse = (int)passIndex == r.firstPass;
+            VkImageLayout oldLayout = firstUse ? VK_IMAGE_LAYOUT_UNDEFINED : r.layout;
+            VkPipelineStageFlags prevStages = r.stages;
+            VkAccessFlags prevAccess = r.access;
+
+            if (firstUse)
+            {
+                prevStages = slot ? slot->stages : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                prevAccess = slot ? slot->access : 0;
+            }
+
+            VkAccessFlags prevWrites = prevAccess & WriteAccess;
+            bool writes = (info.access & WriteAccess) != 0;
+
+            // read after write, write after write/read (execution dependency only) or a layout transition
+            bool hazard = prevWrites || (writes && prevStages) || oldLayout != info.layout;
+
+            if (hazard)
+            {
+                barriers.push_back(imageBarrier(r, oldLayout, info.layout, prevWrites, info.access));
+                srcStages |= prevStages ? prevStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                dstStages |= info.stages;
+                r.stages = info.stages;
+                r.access = info.access;
+            }
+            else
+            {
+                // reads after reads only need to be tracked
+                r.stages |= info.stages;
+                r.access |= info.access;
+            }
+
+            r.layout = info.layout;
+
+            if (slot)
+            {
+                slot->stages = r.stages;
+                slot->access = r.access;
+            }
+        }
+
+        if (!barriers.empty())
+            vkCmdPipelineBarrier(cmdBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+    }
+
+    static void finishPass(RenderGraph &graph, const RenderGraph::Pass &pass)
+    {
+        for (const RenderGraph::Access &a : pass.accesses)
+        {
+            if (a.layoutAfter != VK_IMAGE_LAYOUT_UNDEFINED)
+                graph.resources[a.resource].layout = a.layoutAfter;
+        }
+    }
+
+    bool executeRenderGraph(RenderGraph &graph, VkCommandBuffer cmdBuffer)
+    {
+        // resuming after a pass recorded by the caller
+        if (graph.nextPass > 0)
+            finishPass(graph, graph.passes[graph.nextPass - 1]);
+
+        while (graph.nextPass < graph.passes.size())
+        {
+            size_t passIndex = graph.nextPass++;
+            RenderGraph::Pass &pass = graph.passes[passIndex];
+
+            if (pass.culled)
+                continue;
+
+            recordBarriers(graph, passIndex, cmdBuffer);
+
+            if (!pass.record)
+                return true;
+
+            pass.record(cmdBuffer);
+            finishPass(graph, pass);
+        }
+
+        // hand imported images back in the layout their owner expects
+        std::vector<VkImageMemoryBarrier> barriers;
+        VkPipelineStageFlags srcStages = 0;
+
+        for (RenderGraph::Resource &r : graph.resources)
+        {
+            if (!r.imported || r.firstPass < 0 || r.layout == r.finalLayout)
+                continue;
+
+            barriers.push_back(imageBarrier(r, r.layout, r.finalLayout, r.access & WriteAccess, 0));
+            srcStages |= r.stages;
+            r.layout = r.finalLayout;
+        }
+
+        if (!barriers.empty())
+            vkCmdPipelineBarrier(cmdBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+
+        graph.nextPass = 0;
+        return false;
+    }
+
+    void deferDestroy(DeletionQueue &queue, uint64_t retireValue, RenderGraph &graph)
+    {
+        for (RenderGraph::Resource &r : graph.resources)
+        {
+            // imported images belong to someone else, memory is freed below
+            if (!r.imported)
+                deferDestroy(queue, retireValue, r.texture);
+        }
+
+        for (RenderGraph::MemorySlot &slot : graph.memory)
+            deferDestroy(queue, retireValue, DeletionQueue::MEMORY, (uint64_t)(uintptr_t)slot.allocation, slot.allocation);
+
+        graph.resources.clear();
+        graph.passes.clear();
+        graph.memory.clear();
+        graph.nextPass = 0;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "renderer/vulkan/DeletionQueue.hpp"
+#include "renderer/vulkan/Device.hpp"
+#include "renderer/vulkan/Image.hpp"
+#include <functional>
+#include <vector>
+
+/*
+ *  Frame graph: passes declare the images they read and write - the graph culls passes nothing depends on,
+ *  records batched barriers between them and places transient images with disjoint lifetimes in shared memory
+ */
+
+namespace vk
+{
+    struct RenderGraph
+    {
+        enum AccessType
+        {
+            COLOR_ATTACHMENT, // color and resolve targets
+            DEPTH_ATTACHMENT,
+            SAMPLED
+        };
+
+        struct Access
+        {
+            uint32_t      resource;
+            AccessType    type;
+            VkImageLayout layoutAfter; // render passes may leave attachments in a different layout (final layout) - undefined if not
+        };
+
+        struct Resource
+        {
+            const char *name;
+            bool imported;              // owned elsewhere (swapchain image) and set each frame
+            VkImageLayout finalLayout;  // imported only: layout expected by the owner at the end of the frame
+            VkFormat format;
+            VkExtent2D extent;
+            VkSampleCountFlagBits sampleCount;
+            Texture texture;            // transient images are created by compileRenderGraph()
+            int memorySlot = -1;
+            int firstPass = -1;         // lifetime in (live) pass indices
+            int lastPass  = -1;
+            // synchronization state - carried over between frames
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags stages = 0;
+            VkAccessFlags access = 0;
+        };
+
+        struct Pass
+        {
+            const char *name;
+            std::vector<Access> accesses;
+            // empty if the caller records the pass itself - execution stops in front of it
+            std::function<void(VkCommandBuffer)> record;
+            bool culled = false;
+        };
+
+        // memory shared by transient images that are never alive at the same time
+        struct MemorySlot
+        {
+            VmaAllocation allocation = VK_NULL_HANDLE;
+            VkPipelineStageFlags stages = 0; // last use of any image placed here
+            VkAccessFlags access = 0;
+        };
+
+        std::vector<Resource>   resources;
+        std::vector<Pass>       passes;
+        std::vector<MemorySlot> memory;
+        size_t nextPass = 0;
+    };
+
+    uint32_t addTransientImage(RenderGraph &graph, const char *name, VkFormat format, const VkExtent2D &extent, VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT);
+    // imported images are expected to be made available by a semaphore wait at the color attachment output stage (swapchain acquire)
+    uint32_t addImportedImage(RenderGraph &graph, const char *name, VkImageLayout finalLayout);
+    void     setImportedImage(RenderGraph &graph, uint32_t resource, VkImage image, VkImageView imageView, VkFormat format);
+    uint32_t addPass(RenderGraph &graph, const char *name, std::function<void(VkCommandBuffer)> record = nullptr);
+    void     addAccess(RenderGraph &graph, uint32_t pass, uint32_t resource, RenderGraph::AccessType type, VkImageLayout layoutAfter = VK_IMAGE_LAYOUT_UNDEFINED);
+    // cull unused passes, then create transient images and their (aliased) memory
+    VkResult compileRenderGraph(const Device &device, RenderGraph &graph);
+    // record barriers and passes - returns true when stopping in front of a pass recorded by the caller, call again once it's done
+    bool     executeRenderGraph(RenderGraph &graph, VkCommandBuffer cmdBuffer);
+    // transient images and memory may still be used by frames in flight - the graph is left empty
+    void     deferDestroy(DeletionQueue &queue, uint64_t retireValue, RenderGraph &graph);
+}
@@ -0,0 +1,47 @@
+#include "renderer/vulkan/Sync.hpp"
+#include "Utils.hpp"
+
+namespace vk
+{
+    VkResult createTimeline(const Device &device, Timeline *timeline)
+    {
+        LOG_MESSAGE_ASSERT(device.timelineSemaphores, "Timeline semaphores not enabled on this device!");
+
+        VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo sCreateInfo = {};
+        sCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        sCreateInfo.pNext = &typeInfo;
+
+        timeline->value = 0;
+        return vkCreateSemaphore(device.logical, &sCreateInfo, nullptr, &timeline->semaphore);
+    }
+
+    void destroyTimeline(const Device &device, Timeline &timeline)
+    {
+        vkDestroySemaphore(device.logical, timeline.semaphore, nullptr);
+        timeline.semaphore = VK_NULL_HANDLE;
+        timeline.value = 0;
+    }
+
+    VkResult waitTimeline(const Device &device, const Timeline &timeline, uint64_t value, uint64_t timeout)
+    {
+        VkSemaphoreWaitInfoKHR waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline.semaphore;
+        waitInfo.pValues = &value;
+
+        return device.waitSemaphores(device.logical, &waitInfo, timeout);
+    }
+
+    uint64_t completedTimelineValue(const Device &device, const Timeline &timeline)
+    {
+        uint64_t value = 0;
+        VK_VERIFY(device.getSemaphoreCounterValue(device.logical, timeline.semaphore, &value));
+        return value;
+    }
+}
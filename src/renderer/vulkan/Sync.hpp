@@ -0,0 +1,17 @@
+#pragma once
+
+#include "renderer/vulkan/Base.hpp"
+
+/*
+ *  Timeline semaphore helpers (VK_KHR_timeline_semaphore)
+ */
+
+namespace vk
+{
+    VkResult createTimeline(const Device &device, Timeline *timeline);
+    void     destroyTimeline(const Device &device, Timeline &timeline);
+    // block until the GPU has signaled value on the timeline (timeout in nanoseconds)
+    VkResult waitTimeline(const Device &device, const Timeline &timeline, uint64_t value, uint64_t timeout = UINT64_MAX);
+    // highest value signaled by the GPU so far
+    uint64_t completedTimelineValue(const Device &device, const Timeline &timeline);
+}